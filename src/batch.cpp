@@ -0,0 +1,265 @@
+#include "calibrator.h"
+#include "functions.h"
+
+#include <experimental/filesystem>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <map>
+
+using namespace std;
+namespace fs = std::experimental::filesystem;
+
+/**
+ * =====================================================================
+ * Headless Batch Calibration
+ * =====================================================================
+ * Detects the checkerboard on every frame of a directory of images or a
+ * video in parallel, selects a diverse subset of views, calibrates and
+ * exports the same YAML as the Results tab.
+ * =====================================================================
+ */
+
+struct Detection {
+    int frame = 0;
+    vector<cv::Point2f> corners;
+    ccalib::CheckerboardFrame pose;
+};
+
+static const char *keys =
+        "{help h usage ?   |                 | print this message }"
+        "{@input           |                 | directory of images or video file }"
+        "{rows             | 8               | checkerboard rows }"
+        "{cols             | 11              | checkerboard columns }"
+        "{size             | 0.022           | checkerboard square size in [m] }"
+        "{output o         | calibration.yaml| exported calibration }"
+        "{name             | ccalib-batch    | camera name written to the export }"
+        "{views            | 40              | maximum number of views to calibrate with, 0 for all }"
+        "{step             | 1               | use every n-th video frame }"
+        "{detector         | classic         | classic or sector }"
+        "{solver           | opencv          | opencv or sparse }";
+
+static bool isImage(const fs::path &path) {
+    string ext = path.extension().string();
+    transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".bmp" || ext == ".tif" || ext == ".tiff" ||
+           ext == ".pgm" || ext == ".ppm";
+}
+
+/**
+ * Greedily picks views that are furthest apart in position, size and skew
+ * of the checkerboard, starting with the largest board.
+ */
+static vector<Detection> selectViews(const vector<Detection> &detections, const int &maxViews) {
+    if (maxViews <= 0 || (int) detections.size() <= maxViews)
+        return detections;
+
+    auto distance = [](const ccalib::CheckerboardFrame &a, const ccalib::CheckerboardFrame &b) {
+        cv::Vec4f d(a.pos.x - b.pos.x, a.pos.y - b.pos.y, a.size - b.size, a.skew - b.skew);
+        return d.dot(d);
+    };
+
+    vector<float> nearest(detections.size(), FLT_MAX);
+    vector<Detection> selected;
+    size_t next = 0;
+    for (size_t i = 1; i < detections.size(); i++)
+        if (detections[i].pose.size > detections[next].pose.size)
+            next = i;
+    while ((int) selected.size() < maxViews) {
+        selected.push_back(detections[next]);
+        nearest[next] = -1.0f;
+        for (size_t i = 0; i < detections.size(); i++)
+            if (nearest[i] >= 0.0f)
+                nearest[i] = min(nearest[i], distance(detections[i].pose, detections[next].pose));
+        next = max_element(nearest.begin(), nearest.end()) - nearest.begin();
+    }
+    return selected;
+}
+
+int main(int argc, char **argv) {
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about("ccalib-batch: headless camera calibration");
+    if (parser.has("help") || !parser.has("@input")) {
+        parser.printMessage();
+        return parser.has("help") ? 0 : 1;
+    }
+    string input = parser.get<string>("@input");
+    int rows = parser.get<int>("rows");
+    int cols = parser.get<int>("cols");
+    auto squareSize = parser.get<float>("size");
+    string output = parser.get<string>("output");
+    string name = parser.get<string>("name");
+    int maxViews = parser.get<int>("views");
+    int step = max(1, parser.get<int>("step"));
+    string detectorArg = parser.get<string>("detector");
+    string solverArg = parser.get<string>("solver");
+    if (!parser.check()) {
+        parser.printErrors();
+        return 1;
+    }
+    if (detectorArg != "classic" && detectorArg != "sector") {
+        cerr << "Unknown detector " << detectorArg << ", use classic or sector" << endl;
+        return 1;
+    }
+    if (solverArg != "opencv" && solverArg != "sparse") {
+        cerr << "Unknown solver " << solverArg << ", use opencv or sparse" << endl;
+        return 1;
+    }
+    auto backend = detectorArg == "sector" ? ccalib::DETECTOR_SECTOR : ccalib::DETECTOR_CLASSIC;
+    auto solver = solverArg == "sparse" ? ccalib::SOLVER_SPARSE : ccalib::SOLVER_OPENCV;
+    if (!ccalib::isDetectorAvailable(backend)) {
+        cerr << "Detector " << ccalib::detectorName(backend) << " is not available in this OpenCV build" << endl;
+        return 1;
+    }
+
+    // Collect the image files, video frames are decoded chunk by chunk during detection
+    vector<string> files;
+    cv::VideoCapture video;
+    if (fs::is_directory(input)) {
+        for (const auto &entry : fs::directory_iterator(input))
+            if (fs::is_regular_file(entry.path()) && isImage(entry.path()))
+                files.push_back(entry.path().string());
+        sort(files.begin(), files.end());
+    } else if (!video.open(input)) {
+        cerr << "Can't open " << input << endl;
+        return 1;
+    }
+
+    // Detect on all cores, only a chunk of frames is held in memory at a time
+    const int chunkSize = max(32, 4 * cv::getNumThreads());
+    vector<Detection> results;
+    vector<char> found;
+    vector<cv::Size> sizes;
+    std::atomic<int> failedLoads{0};
+    vector<cv::Mat> chunk;
+    int frameCount = 0, videoFrame = 0;
+    while (true) {
+        // Video frames are decoded here, images are loaded by the detection threads
+        int first = frameCount;
+        int chunkCount;
+        chunk.clear();
+        if (files.empty()) {
+            cv::Mat frame, gray;
+            while ((int) chunk.size() < chunkSize && video.grab()) {
+                if (videoFrame++ % step || !video.retrieve(frame))
+                    continue;
+                cv::cvtColor(frame, gray, cv::COLOR_BGR2GRAY);
+                chunk.push_back(gray.clone());
+            }
+            chunkCount = (int) chunk.size();
+        } else
+            chunkCount = min(chunkSize, (int) files.size() - first);
+        if (chunkCount == 0)
+            break;
+
+        frameCount += chunkCount;
+        results.resize(frameCount);
+        found.resize(frameCount, 0);
+        sizes.resize(frameCount);
+        cv::parallel_for_(cv::Range(first, frameCount), [&](const cv::Range &range) {
+            ccalib::Calibrator calib(rows, cols, squareSize);
+            calib.setDetector(backend);
+            for (int i = range.start; i < range.end; i++) {
+                cv::Mat gray = files.empty() ? chunk[i - first] : cv::imread(files[i], cv::IMREAD_GRAYSCALE);
+                if (gray.empty()) {
+                    failedLoads++;
+                    continue;
+                }
+                sizes[i] = gray.size();
+                results[i].frame = i;
+                if (!calib.findCorners(gray, results[i].corners)) {
+                    results[i].corners.clear();
+                    continue;
+                }
+
+                ccalib::CameraParameters camParams;
+                camParams.width = gray.cols;
+                camParams.height = gray.rows;
+                camParams.ratio = (float) gray.cols / gray.rows;
+                ccalib::Corners frameCorners;
+                calib.computeFrame(results[i].corners, camParams, results[i].pose, frameCorners);
+                found[i] = 1;
+            }
+        });
+    }
+    chunk.clear();
+    if (frameCount == 0) {
+        cerr << "No frames found in " << input << endl;
+        return 1;
+    }
+
+    // Only frames of the most common size can be calibrated together
+    map<pair<int, int>, int> sizeHistogram;
+    for (const auto &s : sizes)
+        if (s.area() > 0)
+            sizeHistogram[make_pair(s.width, s.height)]++;
+    cv::Size imageSize;
+    int sizeCount = 0;
+    for (const auto &bin : sizeHistogram) {
+        if (bin.second > sizeCount) {
+            imageSize = cv::Size(bin.first.first, bin.first.second);
+            sizeCount = bin.second;
+        }
+    }
+    vector<Detection> detections;
+    for (int i = 0; i < frameCount; i++)
+        if (found[i] && sizes[i] == imageSize)
+            detections.push_back(results[i]);
+
+    cout << "Frames:    " << frameCount << (failedLoads ? " (" + to_string(failedLoads) + " unreadable)" : "")
+         << endl;
+    cout << "Detected:  " << detections.size() << endl;
+    if (detections.size() < 4) {
+        cerr << "At least 4 views with a checkerboard are needed" << endl;
+        return 1;
+    }
+
+    // Calibrate, then once more without outliers
+    vector<Detection> selected = selectViews(detections, maxViews);
+    ccalib::Calibrator calib(rows, cols, squareSize);
+    calib.solver = solver;
+    calib.incremental = false;
+    ccalib::CalibrationParameters params;
+    vector<double> errs;
+    auto calibrate = [&]() {
+        vector<ccalib::CalibrationView> views(selected.size());
+        for (size_t i = 0; i < selected.size(); i++) {
+            views[i].id = selected[i].frame;
+            views[i].corners = selected[i].corners;
+        }
+        params = ccalib::CalibrationParameters();
+        return calib.calibrateCamera(views, imageSize, params, errs);
+    };
+    bool calibrated;
+    try {
+        calibrated = calibrate();
+        vector<double> sorted(errs);
+        nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+        double limit = 3.0 * sorted[sorted.size() / 2];
+        vector<Detection> inliers;
+        for (size_t i = 0; i < selected.size(); i++)
+            if (errs[i] <= limit)
+                inliers.push_back(selected[i]);
+        if (inliers.size() >= 4 && inliers.size() < selected.size()) {
+            selected = inliers;
+            calibrated = calibrate();
+        }
+    } catch (const cv::Exception &e) {
+        cerr << "Calibration failed: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Selected:  " << selected.size() << endl;
+    cout << "RMS error: " << params.reprojErr << " px (std " << params.reprojErrVar << ")" << endl;
+    cout << "K = " << params.K << endl;
+    cout << "D = " << params.D.t() << endl;
+
+    if (!ccalib::writeCalibration(output, params, name, imageSize)) {
+        cerr << "Can't write " << output << endl;
+        return 1;
+    }
+    cout << "Written:   " << output << endl;
+
+    // Non zero exit on a poor calibration, so the line can flag the camera
+    return calibrated ? 0 : 2;
+}
@@ -0,0 +1,377 @@
+#include "calibration_scheduler.h"
+#include "calibrator.h"
+#include "functions.h"
+#include "presence_filter.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+
+using namespace std;
+
+/**
+ * =====================================================================
+ * Calibration Hot Path Benchmarks
+ * =====================================================================
+ * Times detection, the presence test, image diff, frame computation,
+ * coverage, reprojection errors and calibration on synthetic inputs.
+ * Boards are rendered with a homography of an ideal pinhole camera,
+ * calibration views are projected with a distorted camera plus noise.
+ * All poses and noise are drawn from a fixed seed, so every run measures
+ * the same work. Results are written as CSV or JSON to compare releases.
+ * =====================================================================
+ */
+
+struct Measurement {
+    string benchmark;
+    string variant;
+    int iterations = 0;
+    double median = 0.0;    // in [ms]
+    double min = 0.0;
+    double mean = 0.0;
+    bool ok = true;         // result of the measured call was valid
+};
+
+struct SyntheticView {
+    cv::Mat rvec, tvec;
+    vector<cv::Point2f> corners;
+};
+
+static const char *keys =
+        "{help h usage ?   |      | print this message }"
+        "{repetitions r    | 20   | timed repetitions per benchmark, calibration runs a fifth of it }"
+        "{filter           |      | only run benchmarks whose name contains this }"
+        "{format           | csv  | csv or json }"
+        "{output o         |      | write results to this file instead of stdout }"
+        "{seed             | 42   | seed of the synthetic scenes }";
+
+static cv::Mat cameraMatrix(const cv::Size &imgSize) {
+    double f = 0.9 * imgSize.width;
+    return (cv::Mat_<double>(3, 3) << f, 0, imgSize.width / 2.0, 0, f, imgSize.height / 2.0, 0, 0, 1);
+}
+
+static vector<cv::Point3f> boardPoints(const int &rows, const int &cols, const float &square) {
+    vector<cv::Point3f> points;
+    for (int i = 0; i < rows - 1; ++i)
+        for (int j = 0; j < cols - 1; ++j)
+            points.emplace_back(j * square, i * square, 0);
+    return points;
+}
+
+/**
+ * Draws a random board pose in front of the camera.
+ *
+ * @param fill board width relative to the image width
+ * @param tilt maximum rotation around each axis in [rad]
+ */
+static void randomPose(cv::RNG &rng, const cv::Mat &K, const cv::Size &imgSize, const int &rows, const int &cols,
+                       const float &square, const double &fill, const double &tilt, cv::Mat &rvec, cv::Mat &tvec) {
+    rvec = (cv::Mat_<double>(3, 1) << rng.uniform(-tilt, tilt), rng.uniform(-tilt, tilt),
+            rng.uniform(-tilt, tilt) * 0.5);
+    double z = K.at<double>(0, 0) * cols * square / (fill * imgSize.width);
+    cv::Mat center = (cv::Mat_<double>(3, 1) << (cols - 2) * square / 2.0, (rows - 2) * square / 2.0, 0.0);
+    cv::Mat target = (cv::Mat_<double>(3, 1) << rng.uniform(-0.15, 0.15) * z, rng.uniform(-0.1, 0.1) * z, z);
+    cv::Mat R;
+    cv::Rodrigues(rvec, R);
+    tvec = target - R * center;
+}
+
+/**
+ * Renders the board with a quiet zone of one square, including blur and
+ * sensor noise, into a gray image.
+ */
+static cv::Mat renderBoard(cv::RNG &rng, const cv::Mat &K, const cv::Size &imgSize, const int &rows, const int &cols,
+                           const float &square, const cv::Mat &rvec, const cv::Mat &tvec) {
+    const int px = 32;
+    cv::Mat board(px * (rows + 2), px * (cols + 2), CV_8UC1, cv::Scalar(255));
+    for (int i = 0; i < rows; i++)
+        for (int j = 0; j < cols; j++)
+            if ((i + j) % 2 == 0)
+                board(cv::Rect((j + 1) * px, (i + 1) * px, px, px)).setTo(0);
+
+    // First inner corner lies two squares into the texture
+    vector<cv::Point2f> texture{cv::Point2f(0, 0), cv::Point2f(board.cols, 0), cv::Point2f(board.cols, board.rows),
+                                cv::Point2f(0, board.rows)};
+    vector<cv::Point3f> object;
+    for (const auto &t : texture)
+        object.emplace_back((t.x / px - 2) * square, (t.y / px - 2) * square, 0);
+    vector<cv::Point2f> image;
+    cv::projectPoints(object, rvec, tvec, K, cv::noArray(), image);
+
+    cv::Mat gray;
+    cv::warpPerspective(board, gray, cv::getPerspectiveTransform(texture, image), imgSize, cv::INTER_LINEAR,
+                        cv::BORDER_CONSTANT, cv::Scalar(128));
+    cv::GaussianBlur(gray, gray, cv::Size(3, 3), 0.8);
+    cv::Mat noise(imgSize, CV_16SC1);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 3);
+    cv::Mat noisy;
+    gray.convertTo(noisy, CV_16SC1);
+    noisy += noise;
+    noisy.convertTo(gray, CV_8UC1);
+    return gray;
+}
+
+/**
+ * Projects the board in random poses through a distorted camera. Views
+ * not fully inside the image are drawn again.
+ */
+static vector<SyntheticView> projectViews(cv::RNG &rng, const int &count, const cv::Mat &K, const cv::Mat &D,
+                                          const cv::Size &imgSize, const int &rows, const int &cols,
+                                          const float &square) {
+    vector<cv::Point3f> object = boardPoints(rows, cols, square);
+    const cv::Rect2f bounds(0, 0, imgSize.width, imgSize.height);
+    vector<SyntheticView> views;
+    while ((int) views.size() < count) {
+        SyntheticView view;
+        randomPose(rng, K, imgSize, rows, cols, square, rng.uniform(0.35, 0.85), 0.6, view.rvec, view.tvec);
+        cv::projectPoints(object, view.rvec, view.tvec, K, D, view.corners);
+        bool inside = true;
+        for (auto &c : view.corners) {
+            c += cv::Point2f((float) rng.gaussian(0.2), (float) rng.gaussian(0.2));
+            inside &= bounds.contains(c);
+        }
+        if (inside)
+            views.push_back(view);
+    }
+    return views;
+}
+
+/**
+ * Runs the function once untimed, then the given number of timed repetitions.
+ */
+static Measurement measure(const string &benchmark, const string &variant, const int &repetitions,
+                           const function<bool()> &run) {
+    Measurement m;
+    m.benchmark = benchmark;
+    m.variant = variant;
+    m.iterations = max(1, repetitions);
+    m.ok = run();
+
+    vector<double> times;
+    for (int i = 0; i < m.iterations; i++) {
+        auto start = chrono::steady_clock::now();
+        m.ok &= run();
+        times.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    m.median = times[times.size() / 2];
+    m.min = times.front();
+    m.mean = accumulate(times.begin(), times.end(), 0.0) / times.size();
+    return m;
+}
+
+static void writeResults(ostream &out, const vector<Measurement> &results, const bool &json) {
+    out << fixed << setprecision(4);
+    if (!json) {
+        out << "benchmark,variant,iterations,median_ms,min_ms,mean_ms,ok" << endl;
+        for (const auto &m : results)
+            out << m.benchmark << "," << m.variant << "," << m.iterations << "," << m.median << "," << m.min << ","
+                << m.mean << "," << m.ok << endl;
+        return;
+    }
+    out << "[" << endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &m = results[i];
+        out << "  {\"benchmark\": \"" << m.benchmark << "\", \"variant\": \"" << m.variant
+            << "\", \"iterations\": " << m.iterations << ", \"median_ms\": " << m.median << ", \"min_ms\": " << m.min
+            << ", \"mean_ms\": " << m.mean << ", \"ok\": " << (m.ok ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    out << "]" << endl;
+}
+
+int main(int argc, char **argv) {
+    cv::CommandLineParser parser(argc, argv, keys);
+    parser.about("ccalib_bench: benchmarks of the calibration hot paths");
+    if (parser.has("help")) {
+        parser.printMessage();
+        return 0;
+    }
+    int repetitions = max(1, parser.get<int>("repetitions"));
+    string filter = parser.get<string>("filter");
+    bool json = parser.get<string>("format") == "json";
+    string output = parser.get<string>("output");
+    auto seed = (uint64) parser.get<int>("seed");
+    if (!parser.check()) {
+        parser.printErrors();
+        return 1;
+    }
+    auto enabled = [&filter](const string &benchmark) {
+        return filter.empty() || benchmark.find(filter) != string::npos;
+    };
+
+    const float square = 0.022f;
+    const vector<cv::Size> resolutions{cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080)};
+    const vector<cv::Size> boards{cv::Size(7, 10), cv::Size(8, 11), cv::Size(10, 15)};     // rows x cols squares
+    const vector<int> viewCounts{10, 25, 50, 100};
+    vector<Measurement> results;
+
+    // Detection and image diff on rendered frames
+    for (const auto &resolution : resolutions) {
+        cv::Mat K = cameraMatrix(resolution);
+        string res = to_string(resolution.width) + "x" + to_string(resolution.height);
+        for (const auto &board : boards) {
+            cv::RNG rng(seed);
+            cv::Mat rvec, tvec;
+            randomPose(rng, K, resolution, board.height, board.width, square, 0.6, 0.3, rvec, tvec);
+            cv::Mat gray = renderBoard(rng, K, resolution, board.height, board.width, square, rvec, tvec);
+            string variant = res + "/" + to_string(board.height) + "x" + to_string(board.width);
+
+            if (enabled("findCorners")) {
+                ccalib::Calibrator calib(board.height, board.width, square);
+                vector<cv::Point2f> corners;
+                results.push_back(measure("findCorners", variant, repetitions, [&]() {
+                    return calib.findCorners(gray, corners);
+                }));
+            }
+
+            if (enabled("presenceCheck")) {
+                ccalib::PresenceFilter presence;
+                const cv::Size patternSize(board.width - 1, board.height - 1);
+                cv::Rect roi;
+                results.push_back(measure("presenceCheck", variant, repetitions * 10, [&]() {
+                    return presence.check(gray, patternSize, roi);
+                }));
+            }
+        }
+
+        if (enabled("computeImageDiff")) {
+            cv::RNG rng(seed);
+            cv::Mat rvec, tvec;
+            randomPose(rng, K, resolution, 8, 11, square, 0.6, 0.3, rvec, tvec);
+            cv::Mat first = renderBoard(rng, K, resolution, 8, 11, square, rvec, tvec);
+            tvec.at<double>(0) += 0.002;
+            cv::Mat second = renderBoard(rng, K, resolution, 8, 11, square, rvec, tvec);
+            cv::Rect rect(resolution.width / 5, resolution.height / 5, resolution.width * 3 / 5,
+                          resolution.height * 3 / 5);
+            results.push_back(measure("computeImageDiff", res, repetitions, [&]() {
+                return ccalib::computeImageDiff(first, second, rect) >= 0.0f;
+            }));
+        }
+    }
+
+    // Frame computation and coverage on projected corners
+    const cv::Size imageSize(1280, 720);
+    cv::Mat K = cameraMatrix(imageSize);
+    cv::Mat D = (cv::Mat_<double>(5, 1) << -0.12, 0.05, 0.0005, -0.0003, -0.01);
+    ccalib::CameraParameters camParams;
+    camParams.width = imageSize.width;
+    camParams.height = imageSize.height;
+    camParams.ratio = (float) imageSize.width / imageSize.height;
+    cv::RNG rng(seed);
+    vector<SyntheticView> views = projectViews(rng, viewCounts.back(), K, D, imageSize, 8, 11, square);
+    ccalib::Calibrator calib(8, 11, square);
+
+    if (enabled("computeFrame")) {
+        ccalib::CheckerboardFrame frame;
+        ccalib::Corners frameCorners;
+        results.push_back(measure("computeFrame", "1280x720/8x11", repetitions * 100, [&]() {
+            calib.computeFrame(views[0].corners, camParams, frame, frameCorners);
+            return frame.size > 0.0f;
+        }));
+    }
+
+    if (enabled("updateCoverage")) {
+        // Snapshots share one small image, only the frame is read
+        cv::Mat thumbnail(48, 64, CV_8UC1, cv::Scalar(128));
+        for (const auto &count : viewCounts) {
+            ccalib::SnapshotStore snapshots;
+            for (int i = 0; i < count; i++) {
+                ccalib::Snapshot snapshot;
+                snapshot.img.data = snapshot.img.gray = thumbnail;
+                snapshot.img.id = i;
+                snapshot.corners = views[i].corners;
+                calib.computeFrame(snapshot.corners, camParams, snapshot.frame, snapshot.frameCorners);
+                snapshots.add(snapshot);
+            }
+            ccalib::CoverageParameters coverage;
+            results.push_back(measure("updateCoverage", to_string(count) + " views", repetitions * 100, [&]() {
+                ccalib::updateCoverage(snapshots, coverage);
+                return coverage.size_max >= coverage.size_min;
+            }));
+        }
+    }
+
+    // Reprojection errors and calibration against the view count
+    for (const auto &count : viewCounts) {
+        ccalib::CalibrationParameters truth;
+        truth.K = K.clone();
+        D.copyTo(truth.D);
+        vector<vector<cv::Point3f>> objectPoints(count, boardPoints(8, 11, square));
+        vector<vector<cv::Point2f>> imagePoints;
+        vector<ccalib::CalibrationView> calibViews;
+        for (int i = 0; i < count; i++) {
+            truth.R.push_back(views[i].rvec);
+            truth.T.push_back(views[i].tvec);
+            imagePoints.push_back(views[i].corners);
+            ccalib::CalibrationView view;
+            view.id = i;
+            view.corners = views[i].corners;
+            calibViews.push_back(view);
+        }
+        string variant = to_string(count) + " views";
+
+        if (enabled("computeReprojectionErrors")) {
+            vector<double> errs;
+            vector<vector<cv::Point2f>> residuals;
+            results.push_back(measure("computeReprojectionErrors", variant, repetitions, [&]() {
+                return calib.computeReprojectionErrors(objectPoints, imagePoints, truth, errs, residuals) < 1.0;
+            }));
+        }
+
+        // Cold start from scratch, and the incremental case of the GUI: the
+        // last view is new, the solution over all others seeds the solver.
+        // SOLVER_OPENCV is the default, so "opencv/warm" is what the GUI runs.
+        const vector<pair<ccalib::CalibrationSolver, string>> solvers{{ccalib::SOLVER_OPENCV, "opencv"},
+                                                                     {ccalib::SOLVER_SPARSE, "sparse"}};
+        for (const auto &solver : solvers) {
+            if (!enabled("calibrateCamera"))
+                continue;
+            ccalib::Calibrator solverCalib(8, 11, square);
+            solverCalib.solver = solver.first;
+            int calibRepetitions = max(1, repetitions / 5);
+            auto calibrate = [&](const ccalib::CalibrationParameters &guess, const vector<ccalib::CalibrationView> &v) {
+                ccalib::CalibrationParameters params = ccalib::cloneParameters(guess);
+                vector<double> errs;
+                try {
+                    solverCalib.calibrateCamera(v, imageSize, params, errs);
+                } catch (const cv::Exception &) {
+                    return false;
+                }
+                return params.reprojErr < 1.0;
+            };
+
+            solverCalib.incremental = false;
+            results.push_back(measure("calibrateCamera", variant + "/" + solver.second, calibRepetitions, [&]() {
+                return calibrate(ccalib::CalibrationParameters(), calibViews);
+            }));
+
+            ccalib::CalibrationParameters previous;
+            vector<double> errs;
+            vector<ccalib::CalibrationView> previousViews(calibViews.begin(), calibViews.end() - 1);
+            try {
+                solverCalib.calibrateCamera(previousViews, imageSize, previous, errs);
+            } catch (const cv::Exception &) {
+                continue;
+            }
+            solverCalib.incremental = true;
+            results.push_back(measure("calibrateCamera", variant + "/" + solver.second + "/warm", calibRepetitions,
+                                      [&]() { return calibrate(previous, calibViews); }));
+        }
+    }
+
+    if (output.empty())
+        writeResults(cout, results, json);
+    else {
+        ofstream file(output);
+        if (!file.is_open()) {
+            cerr << "Can't write " << output << endl;
+            return 1;
+        }
+        writeResults(file, results, json);
+    }
+    return 0;
+}
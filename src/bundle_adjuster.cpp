@@ -0,0 +1,205 @@
+#include "bundle_adjuster.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Sparse Bundle Adjustment
+ * =====================================================================
+ * Levenberg-Marquardt over the intrinsics shared by all views and one
+ * pose per view, matching the model of cv::calibrateCamera with
+ * CALIB_FIX_ASPECT_RATIO | CALIB_FIX_K4 | CALIB_FIX_K5.
+ * Views only couple through the intrinsics, so the normal equations
+ *
+ *   | U   W | |dc|     |gc|
+ *   | W^T V | |dp| = - |gp|     with V block diagonal (6x6 per view)
+ *
+ * are reduced to the 8x8 Schur complement S = U - W V^-1 W^T. Every
+ * iteration is linear in the number of views, the per view Jacobians
+ * (from cv::projectPoints) are evaluated in parallel.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    BundleAdjuster::BundleAdjuster(const std::vector<std::vector<cv::Point3f>> &objectPoints,
+                                   const std::vector<std::vector<cv::Point2f>> &imagePoints) :
+            objectPoints(objectPoints), imagePoints(imagePoints) {}
+
+    BundleAdjuster::~BundleAdjuster() {}
+
+    void BundleAdjuster::unpack(const VecI &intrinsics, cv::Mat &K, cv::Mat &D) {
+        K = (cv::Mat_<double>(3, 3) << aspectRatio * intrinsics(0), 0, intrinsics(1),
+                0, intrinsics(0), intrinsics(2),
+                0, 0, 1);
+        D = cv::Mat::zeros(8, 1, CV_64F);
+        for (int i = 0; i < 5; i++)
+            D.at<double>(i) = intrinsics(3 + i);
+    }
+
+    /**
+     * Computes the squared reprojection error and, if requested, the normal
+     * equation blocks of every view.
+     *
+     * @return sum of squared residuals in [px^2]
+     */
+    double BundleAdjuster::evaluate(const State &state, std::vector<ViewBlock> &blocks, const bool &jacobians) {
+        cv::Mat K, D;
+        unpack(state.intrinsics, K, D);
+        blocks.resize(objectPoints.size());
+
+        cv::parallel_for_(cv::Range(0, (int) objectPoints.size()), [&](const cv::Range &range) {
+            std::vector<cv::Point2f> projected;
+            cv::Mat J;
+            for (int i = range.start; i < range.end; i++) {
+                ViewBlock &block = blocks[i];
+                cv::Mat rvec(state.poses[i].get_minor<3, 1>(0, 0)), tvec(state.poses[i].get_minor<3, 1>(3, 0));
+                if (jacobians)
+                    cv::projectPoints(objectPoints[i], rvec, tvec, K, D, projected, J);
+                else
+                    cv::projectPoints(objectPoints[i], rvec, tvec, K, D, projected);
+
+                auto n = (int) projected.size();
+                cv::Mat r(2 * n, 1, CV_64F);
+                for (int j = 0; j < n; j++) {
+                    r.at<double>(2 * j) = projected[j].x - imagePoints[i][j].x;
+                    r.at<double>(2 * j + 1) = projected[j].y - imagePoints[i][j].y;
+                }
+                block.cost = r.dot(r);
+                if (!jacobians)
+                    continue;
+
+                // Jacobian columns: rvec, tvec, fx, fy, cx, cy, k1, k2, p1, p2, k3, k4, k5, k6
+                // Chain the fixed aspect ratio into f and drop the fixed coefficients
+                cv::Mat Jc(2 * n, INTRINSICS, CV_64F);
+                cv::Mat Jf = Jc.col(0);
+                cv::addWeighted(J.col(6), aspectRatio, J.col(7), 1.0, 0.0, Jf);
+                J.colRange(8, 15).copyTo(Jc.colRange(1, INTRINSICS));
+                cv::Mat Jp = J.colRange(0, POSE);
+
+                block.U = cv::Mat(Jc.t() * Jc);
+                block.W = cv::Mat(Jc.t() * Jp);
+                block.V = cv::Mat(Jp.t() * Jp);
+                block.gc = cv::Mat(Jc.t() * r);
+                block.gp = cv::Mat(Jp.t() * r);
+            }
+        });
+
+        double cost = 0.0;
+        for (const auto &block : blocks)
+            cost += block.cost;
+        return cost;
+    }
+
+    /**
+     * Jointly refines intrinsics and poses.
+     *
+     * @param imageSize size of the calibration images
+     * @param K camera matrix, initial guess if useGuess, fx / fy is kept fixed
+     * @param D distortion coefficients, initial guess if useGuess
+     * @param R rotation vector per view, initial guess if useGuess and not empty
+     * @param T translation vector per view, initial guess if useGuess and not empty
+     * @param useGuess start from the given parameters instead of a closed form estimate
+     * @return RMS reprojection error in [px]
+     */
+    double BundleAdjuster::solve(const cv::Size &imageSize, cv::Mat &K, cv::Mat &D, std::vector<cv::Mat> &R,
+                                 std::vector<cv::Mat> &T, const bool &useGuess) {
+        const auto views = (int) objectPoints.size();
+        State state;
+        state.poses.resize(views);
+
+        // Initial intrinsics
+        cv::Mat K0, D0 = cv::Mat::zeros(8, 1, CV_64F);
+        if (useGuess) {
+            K.convertTo(K0, CV_64F);
+            cv::Mat d;
+            D.reshape(1, (int) D.total()).convertTo(d, CV_64F);
+            d.rowRange(0, min(8, d.rows)).copyTo(D0.rowRange(0, min(8, d.rows)));
+        } else
+            K0 = cv::initCameraMatrix2D(objectPoints, imagePoints, imageSize, 1.0);
+        aspectRatio = K0.at<double>(0, 0) / K0.at<double>(1, 1);
+        state.intrinsics = VecI(K0.at<double>(1, 1), K0.at<double>(0, 2), K0.at<double>(1, 2),
+                                D0.at<double>(0), D0.at<double>(1), D0.at<double>(2), D0.at<double>(3),
+                                D0.at<double>(4));
+
+        // Initial poses, guessed or located with the initial intrinsics
+        bool guessPoses = useGuess && (int) R.size() == views && (int) T.size() == views;
+        unpack(state.intrinsics, K0, D0);
+        cv::parallel_for_(cv::Range(0, views), [&](const cv::Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                cv::Mat rvec, tvec;
+                if (guessPoses && !R[i].empty() && !T[i].empty()) {
+                    R[i].reshape(1, 3).convertTo(rvec, CV_64F);
+                    T[i].reshape(1, 3).convertTo(tvec, CV_64F);
+                } else
+                    cv::solvePnP(objectPoints[i], imagePoints[i], K0, D0, rvec, tvec);
+                for (int k = 0; k < 3; k++) {
+                    state.poses[i](k) = rvec.at<double>(k);
+                    state.poses[i](3 + k) = tvec.at<double>(k);
+                }
+            }
+        });
+
+        std::vector<ViewBlock> blocks, trial;
+        double cost = evaluate(state, blocks, true);
+        double lambda = 1e-3;
+        std::vector<MatPP> Vinv(views);
+        for (int iteration = 0; iteration < maxIterations; iteration++) {
+            // Eliminate the poses, damping the diagonal as in Marquardt's method
+            MatII U, S;
+            VecI b;
+            for (int i = 0; i < views; i++) {
+                MatPP V = blocks[i].V;
+                for (int k = 0; k < POSE; k++)
+                    V(k, k) += lambda * max(V(k, k), 1e-12);
+                Vinv[i] = V.inv(cv::DECOMP_CHOLESKY);
+                MatIP WV = blocks[i].W * Vinv[i];
+                U += blocks[i].U;
+                S -= WV * blocks[i].W.t();
+                b += WV * blocks[i].gp - blocks[i].gc;
+            }
+            for (int k = 0; k < INTRINSICS; k++)
+                U(k, k) += lambda * max(U(k, k), 1e-12);
+            S += U;
+
+            // Solve the reduced system, then back substitute the poses
+            cv::Mat dc;
+            if (!cv::solve(cv::Mat(S), cv::Mat(b), dc, cv::DECOMP_CHOLESKY)) {
+                lambda *= 10.0;
+                continue;
+            }
+            VecI delta = dc;
+            State candidate = state;
+            candidate.intrinsics += delta;
+            for (int i = 0; i < views; i++)
+                candidate.poses[i] += Vinv[i] * (-blocks[i].gp - blocks[i].W.t() * delta);
+
+            double candidateCost = evaluate(candidate, trial, true);
+            if (candidateCost < cost) {
+                double reduction = (cost - candidateCost) / cost;
+                state = candidate;
+                std::swap(blocks, trial);
+                cost = candidateCost;
+                lambda = max(lambda * 0.1, 1e-12);
+                if (reduction < epsilon)
+                    break;
+            } else if ((lambda *= 10.0) > 1e8)
+                break;
+        }
+
+        // Write back in the layout of cv::calibrateCamera
+        unpack(state.intrinsics, K, D);
+        R.resize(views);
+        T.resize(views);
+        int totalPoints = 0;
+        for (int i = 0; i < views; i++) {
+            R[i] = cv::Mat(state.poses[i].get_minor<3, 1>(0, 0)).clone();
+            T[i] = cv::Mat(state.poses[i].get_minor<3, 1>(3, 0)).clone();
+            totalPoints += (int) objectPoints[i].size();
+        }
+        return std::sqrt(cost / max(1, totalPoints));
+    }
+
+} // namespace ccalib
@@ -0,0 +1,60 @@
+#ifndef BUNDLE_ADJUSTER_H
+#define BUNDLE_ADJUSTER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace ccalib {
+
+    class BundleAdjuster {
+    public:
+        // Shared intrinsics: f, cx, cy, k1, k2, p1, p2, k3
+        static const int INTRINSICS = 8;
+        static const int POSE = 6;
+
+        typedef cv::Matx<double, INTRINSICS, INTRINSICS> MatII;
+        typedef cv::Matx<double, INTRINSICS, POSE> MatIP;
+        typedef cv::Matx<double, POSE, POSE> MatPP;
+        typedef cv::Matx<double, INTRINSICS, 1> VecI;
+        typedef cv::Matx<double, POSE, 1> VecP;
+
+    private:
+        struct ViewBlock {
+            MatII U;        // intrinsic x intrinsic normal block
+            MatIP W;        // intrinsic x pose coupling
+            MatPP V;        // pose x pose normal block
+            VecI gc;        // intrinsic gradient
+            VecP gp;        // pose gradient
+            double cost = 0.0;
+        };
+
+        struct State {
+            VecI intrinsics;
+            std::vector<VecP> poses;
+        };
+
+        const std::vector<std::vector<cv::Point3f>> &objectPoints;
+        const std::vector<std::vector<cv::Point2f>> &imagePoints;
+        double aspectRatio = 1.0;   // fx / fy, fixed
+
+        double evaluate(const State &state, std::vector<ViewBlock> &blocks, const bool &jacobians);
+
+        void unpack(const VecI &intrinsics, cv::Mat &K, cv::Mat &D);
+
+    public:
+
+        int maxIterations = 30;
+        double epsilon = 1e-9;      // relative cost reduction to stop at
+
+        BundleAdjuster(const std::vector<std::vector<cv::Point3f>> &objectPoints,
+                       const std::vector<std::vector<cv::Point2f>> &imagePoints);
+
+        ~BundleAdjuster();
+
+        double solve(const cv::Size &imageSize, cv::Mat &K, cv::Mat &D, std::vector<cv::Mat> &R,
+                     std::vector<cv::Mat> &T, const bool &useGuess);
+    };
+
+} // namespace ccalib
+
+#endif // BUNDLE_ADJUSTER_H
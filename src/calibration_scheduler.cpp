@@ -0,0 +1,149 @@
+#include "calibration_scheduler.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Background Calibration
+ * =====================================================================
+ * Calibrates on a single dedicated thread. Every request copies the
+ * corners of its views, so the UI may add or delete snapshots at any time. Requests
+ * arriving during a solve are coalesced, only the newest one is solved
+ * next. Each solve writes into a private result, which is then published
+ * as a new immutable version. Readers keep the version they hold alive.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    CalibrationParameters cloneParameters(const CalibrationParameters &params) {
+        CalibrationParameters copy = params;
+        copy.K = params.K.clone();
+        copy.D = params.D.clone();
+        copy.P = params.P.clone();
+        for (size_t i = 0; i < copy.R.size(); i++)
+            copy.R[i] = params.R[i].clone();
+        for (size_t i = 0; i < copy.T.size(); i++)
+            copy.T[i] = params.T[i].clone();
+        return copy;
+    }
+
+    CalibrationScheduler::CalibrationScheduler() {}
+
+    CalibrationScheduler::~CalibrationScheduler() {
+        stop();
+    }
+
+    void CalibrationScheduler::start() {
+        if (running)
+            return;
+        running = true;
+        worker = std::thread(&CalibrationScheduler::run, this);
+    }
+
+    void CalibrationScheduler::stop() {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            running = false;
+        }
+        jobCondition.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    /**
+     * @return true while a request is queued or being solved
+     */
+    bool CalibrationScheduler::isBusy() {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        return pending || solving;
+    }
+
+    /**
+     * Requests a calibration over the given snapshots, replacing any request
+     * which has not been started yet.
+     *
+     * @param views corners per snapshot to calibrate with, copied
+     * @param imageSize size of the snapshot images
+     * @param calibrator holds the checkerboard dimensions
+     */
+    void CalibrationScheduler::submit(const std::vector<CalibrationView> &views, const cv::Size &imageSize,
+                                      const Calibrator &calibrator) {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            pendingJob.views = views;
+            pendingJob.imageSize = imageSize;
+            pendingJob.checkerboardRows = calibrator.checkerboardRows;
+            pendingJob.checkerboardCols = calibrator.checkerboardCols;
+            pendingJob.checkerboardSize = calibrator.checkerboardSize;
+            pendingJob.incremental = calibrator.incremental;
+            pendingJob.solver = calibrator.solver;
+            pending = true;
+        }
+        jobCondition.notify_one();
+    }
+
+    /**
+     * @return newest published result, nullptr if there is none yet
+     */
+    std::shared_ptr<const CalibrationResult> CalibrationScheduler::latest() {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        return published;
+    }
+
+    /**
+     * Drops pending requests, the result of a running solve and the warm
+     * start. Waits for nothing, the running solve is discarded when done.
+     */
+    void CalibrationScheduler::reset() {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        pending = false;
+        generation++;
+        published.reset();
+        warmStart = CalibrationParameters();
+    }
+
+    void CalibrationScheduler::run() {
+        while (running) {
+            CalibrationJob job;
+            CalibrationParameters params;
+            int jobGeneration;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobCondition.wait(lock, [this] { return pending || !running; });
+                if (!running)
+                    break;
+                job = std::move(pendingJob);
+                pending = false;
+                solving = true;
+                params = cloneParameters(warmStart);
+                jobGeneration = generation;
+            }
+
+            auto result = std::make_shared<CalibrationResult>();
+            Calibrator calib(job.checkerboardRows, job.checkerboardCols, job.checkerboardSize);
+            calib.incremental = job.incremental;
+            calib.solver = job.solver;
+            bool solved = true;
+            try {
+                result->calibrated = calib.calibrateCamera(job.views, job.imageSize, params, result->errs,
+                                                           result->residuals);
+            } catch (const cv::Exception &e) {
+                // Degenerate views, keep the previous result
+                solved = false;
+            }
+            result->params = params;
+
+            std::lock_guard<std::mutex> lock(jobMutex);
+            solving = false;
+            if (!solved || jobGeneration != generation)
+                continue;
+            result->version = ++version;
+            warmStart = result->params;
+            published = result;
+        }
+    }
+
+} // namespace ccalib
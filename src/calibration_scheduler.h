@@ -0,0 +1,74 @@
+#ifndef CALIBRATION_SCHEDULER_H
+#define CALIBRATION_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "calibrator.h"
+#include "structures.h"
+
+namespace ccalib {
+
+    struct CalibrationResult {
+        CalibrationParameters params;
+        std::vector<double> errs;   // per view, in the order of params.viewIds
+        std::vector<std::vector<cv::Point2f>> residuals;   // per view and corner, in [px]
+        bool calibrated = false;
+        int version = 0;
+    };
+
+    struct CalibrationJob {
+        std::vector<CalibrationView> views;
+        cv::Size imageSize;
+        int checkerboardRows = 0;
+        int checkerboardCols = 0;
+        float checkerboardSize = 0.0f;
+        bool incremental = true;
+        CalibrationSolver solver = SOLVER_OPENCV;
+    };
+
+    class CalibrationScheduler {
+    private:
+        std::atomic<bool> running{false};
+        std::thread worker;
+
+        std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        CalibrationJob pendingJob;
+        bool pending = false;
+        bool solving = false;       // a job has been taken and is not finished yet
+        int generation = 0;
+        int version = 0;
+
+        std::shared_ptr<const CalibrationResult> published;
+        CalibrationParameters warmStart;
+
+        void run();
+
+    public:
+
+        CalibrationScheduler();
+
+        ~CalibrationScheduler();
+
+        void start();
+
+        void stop();
+
+        void submit(const std::vector<CalibrationView> &views, const cv::Size &imageSize, const Calibrator &calibrator);
+
+        std::shared_ptr<const CalibrationResult> latest();
+
+        void reset();
+
+        bool isBusy();
+    };
+
+    CalibrationParameters cloneParameters(const CalibrationParameters &params);
+
+} // namespace ccalib
+
+#endif // CALIBRATION_SCHEDULER_H
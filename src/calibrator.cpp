@@ -3,9 +3,11 @@
 //
 
 #include "calibrator.h"
+#include "bundle_adjuster.h"
 #include "functions.h"
+#include "profiler.h"
 
-#include <thread>
+#include <map>
 #include <numeric>
 
 
@@ -14,27 +16,163 @@ using namespace std;
 
 namespace ccalib {
 
-    Calibrator::Calibrator() {}
+    Calibrator::Calibrator() : detector(createDetector(DETECTOR_CLASSIC)), detectorStats(DETECTOR_COUNT) {}
 
-    Calibrator::Calibrator(int rows, int cols, float size) : checkerboardRows(rows), checkerboardCols(cols),
-                                                             checkerboardSize(size) {}
+    Calibrator::Calibrator(int rows, int cols, float size) : detector(createDetector(DETECTOR_CLASSIC)),
+                                                             detectorStats(DETECTOR_COUNT), checkerboardRows(rows),
+                                                             checkerboardCols(cols), checkerboardSize(size) {}
 
     Calibrator::~Calibrator() {}
 
-    bool Calibrator::isCalibrating() {
-        return busy;
+    void Calibrator::setDetector(const DetectorBackend &detectorBackend) {
+        if (detectorBackend == backend || !isDetectorAvailable(detectorBackend))
+            return;
+        backend = detectorBackend;
+        detector = createDetector(backend);
     }
 
-    bool Calibrator::findCorners(cv::Mat &img, std::vector<cv::Point2f> &corners) {
+    DetectorBackend Calibrator::getDetector() const {
+        return backend;
+    }
+
+    const std::vector<DetectorStats> &Calibrator::getDetectorStats() const {
+        return detectorStats;
+    }
+
+    void Calibrator::resetDetectorStats() {
+        detectorStats.assign(DETECTOR_COUNT, DetectorStats());
+    }
+
+    bool Calibrator::findCorners(const cv::Mat &img, std::vector<cv::Point2f> &corners) {
+        // Unbounded search, falls back to all pyramid levels down to full resolution
+        DetectionDiagnostics diagnostics;
+        return findCorners(img, corners, Deadline::max(), diagnostics) == DETECTION_FOUND;
+    }
+
+    /**
+     * Detects the checkerboard within a time budget using an image pyramid.
+     * The grid is searched on the pyramid level sized for speed (searchWidth)
+     * or coarser, if the tracked cost per pixel does not fit the remaining budget.
+     * If the board is not found and time remains, finer levels are searched.
+     * Found corners are refined level by level up to full resolution.
+     * Latency and success rate are collected per detector backend.
+     * The search itself can't be interrupted, the deadline and the cancel
+     * flag are checked before and after each stage.
+     *
+     * @param img image to search
+     * @param corners detected corners, unrefined if the refinement ran out of time
+     * @param deadline point in time by which the detection needs to finish
+     * @param diagnostics timing and search details of this call
+     * @param cancel optional flag to abort between stages
+     * @return detection status
+     */
+    DetectionStatus Calibrator::findCorners(const cv::Mat &img, std::vector<cv::Point2f> &corners,
+                                            const Deadline &deadline, DetectionDiagnostics &diagnostics,
+                                            const std::atomic<bool> *cancel) {
+        ScopedTimer timer("Detection");
+        auto start = std::chrono::steady_clock::now();
+        auto elapsedSince = [](const Deadline &t) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+        };
+        auto remaining = [&deadline]() {
+            return std::chrono::duration<double, std::milli>(deadline - std::chrono::steady_clock::now()).count();
+        };
+        DetectorStats &stats = detectorStats[backend];
+        auto finish = [&](const DetectionStatus &status) {
+            diagnostics.status = status;
+            diagnostics.elapsed = elapsedSince(start);
+            if (status != DETECTION_CANCELLED) {
+                stats.attempts++;
+                stats.successes += status == DETECTION_FOUND;
+                stats.latency += (diagnostics.elapsed - stats.latency) / stats.attempts;
+            }
+            return status;
+        };
+
+        diagnostics = DetectionDiagnostics();
+        diagnostics.budget = std::chrono::duration<double, std::milli>(deadline - start).count();
+        corners.clear();
+        if (diagnostics.budget <= 0.0)
+            return finish(DETECTION_TIMED_OUT);
+
+        cv::Mat gray = img;
         if (img.channels() == 3)
-            cv::cvtColor(img, img, cv::COLOR_RGB2GRAY);
-        if (cv::findChessboardCorners(img, cv::Size(checkerboardCols - 1, checkerboardRows - 1), corners,
-                                      CV_CALIB_CB_ADAPTIVE_THRESH | CV_CALIB_CB_NORMALIZE_IMAGE |
-                                      CV_CALIB_CB_FAST_CHECK))
-            cv::cornerSubPix(img, corners, cv::Size(11, 11), cv::Size(-1, -1),
-                             cv::TermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 30, 0.1));
-        cv::cvtColor(img, img, cv::COLOR_GRAY2RGB);
-        return corners.size() == (checkerboardRows - 1) * (checkerboardCols - 1);
+            cv::cvtColor(img, gray, cv::COLOR_RGB2GRAY);
+
+        // Build pyramid down to the search width
+        std::vector<cv::Mat> pyramid{gray};
+        while (pyramid.back().cols / 2 >= searchWidth) {
+            pyramid.emplace_back();
+            cv::pyrDown(pyramid[pyramid.size() - 2], pyramid.back());
+        }
+
+        // Go coarser if the expected cost exceeds the budget, leaving some time for the refinement
+        auto expectedCost = [&stats](const cv::Mat &level) { return stats.cost * level.total() / 1e6; };
+        while (expectedCost(pyramid.back()) > diagnostics.budget * 0.8 && pyramid.back().cols / 2 >= 160) {
+            pyramid.emplace_back();
+            cv::pyrDown(pyramid[pyramid.size() - 2], pyramid.back());
+        }
+
+        // Search from coarse to fine until found or out of time
+        auto level = (int) pyramid.size() - 1;
+        const cv::Size patternSize(checkerboardCols - 1, checkerboardRows - 1);
+        while (true) {
+            if (cancel && *cancel)
+                return finish(DETECTION_CANCELLED);
+
+            auto searchStart = std::chrono::steady_clock::now();
+            bool found = detector->detect(pyramid[level], patternSize, corners);
+
+            // Update running cost estimate
+            double cost = elapsedSince(searchStart) / max(1e-6, pyramid[level].total() / 1e6);
+            stats.cost = stats.cost > 0.0 ? 0.8 * stats.cost + 0.2 * cost : cost;
+            diagnostics.scale = (double) gray.cols / pyramid[level].cols;
+            diagnostics.cornersFound = (int) corners.size();
+
+            if (found)
+                break;
+            if (level == 0 || expectedCost(pyramid[level - 1]) > remaining())
+                return finish(remaining() < 0.0 ? DETECTION_TIMED_OUT : DETECTION_NOT_FOUND);
+            level--;
+        }
+
+        // Refine on every level up to full resolution
+        for (const int searchLevel = level; level >= 0; level--) {
+            if (level < searchLevel) {
+                cv::Size finer = pyramid[level].size(), coarser = pyramid[level + 1].size();
+                for (auto &p : corners) {
+                    p.x *= (float) finer.width / coarser.width;
+                    p.y *= (float) finer.height / coarser.height;
+                }
+                diagnostics.scale = (double) gray.cols / pyramid[level].cols;
+            }
+            if ((cancel && *cancel) || remaining() < 0.0) {
+                // Return the unrefined guesses at full resolution
+                for (auto &p : corners)
+                    p *= (float) diagnostics.scale;
+                return finish(cancel && *cancel ? DETECTION_CANCELLED : DETECTION_TIMED_OUT);
+            }
+            if (level == searchLevel && detector->isSubPixel())
+                continue;
+            int window = refinementWindow(corners);
+            cv::cornerSubPix(pyramid[level], corners, cv::Size(window, window), cv::Size(-1, -1),
+                             cv::TermCriteria(cv::TermCriteria::EPS | cv::TermCriteria::COUNT, 30, 0.1));
+        }
+        diagnostics.refined = true;
+        return finish(DETECTION_FOUND);
+    }
+
+    /**
+     * Half size of the cornerSubPix search window. Matches the default of 11
+     * unless the squares are too small, in which case the window would pick
+     * up neighbouring corners.
+     */
+    int Calibrator::refinementWindow(const std::vector<cv::Point2f> &corners) {
+        double spacing = DBL_MAX;
+        for (int i = 0; i + 1 < (int) corners.size(); i++)
+            if ((i + 1) % (checkerboardCols - 1))
+                spacing = min(spacing, cv::norm(corners[i + 1] - corners[i]));
+        return max(2, (int) min(11.0, spacing * 0.4));
     }
 
     void Calibrator::computeFrame(const std::vector<cv::Point2f> &corners, const ccalib::CameraParameters &camParams,
@@ -51,65 +189,180 @@ namespace ccalib {
         frameCorners = fc;
     }
 
-    // As taken from opencv docs
     double Calibrator::computeReprojectionErrors(const std::vector<std::vector<cv::Point3f> > &objectPoints,
                                                  const std::vector<std::vector<cv::Point2f> > &imagePoints,
                                                  const ccalib::CalibrationParameters &params,
                                                  std::vector<double> &perViewErrors) {
-        std::vector<cv::Point2f> imagePoints2;
-        int i, totalPoints = 0;
-        double totalErr = 0, err;
-        perViewErrors.resize(objectPoints.size());
-
-        for (i = 0; i < (int) objectPoints.size(); ++i) {
-            projectPoints(cv::Mat(objectPoints[i]), params.R[i], params.T[i], params.K, params.D, imagePoints2);
-            err = norm(cv::Mat(imagePoints[i]), cv::Mat(imagePoints2), CV_L2); // difference
-
-            auto n = (int) objectPoints[i].size();
-            perViewErrors[i] = std::sqrt(err * err / n); // save for this view
-            totalErr += err * err; // sum it up
-            totalPoints += n;
-        }
+        std::vector<std::vector<cv::Point2f>> residuals;
+        return computeReprojectionErrors(objectPoints, imagePoints, params, perViewErrors, residuals);
+    }
+
+    /**
+     * Evaluates the reprojection error of every view in parallel. The
+     * projection (pinhole, radial k1-k6, tangential p1, p2) is evaluated
+     * inline per point, without the per view allocations of cv::projectPoints.
+     *
+     * @param objectPoints checkerboard corners in board coordinates
+     * @param imagePoints detected corners per view
+     * @param params calibration with a pose per view
+     * @param perViewErrors RMS error per view in [px]
+     * @param residuals detected minus projected corner per view in [px]
+     * @return RMS error over all corners in [px]
+     */
+    double Calibrator::computeReprojectionErrors(const std::vector<std::vector<cv::Point3f> > &objectPoints,
+                                                 const std::vector<std::vector<cv::Point2f> > &imagePoints,
+                                                 const ccalib::CalibrationParameters &params,
+                                                 std::vector<double> &perViewErrors,
+                                                 std::vector<std::vector<cv::Point2f>> &residuals) {
+        const auto views = (int) objectPoints.size();
+        perViewErrors.resize(views);
+        residuals.resize(views);
+
+        cv::Mat K, D;
+        params.K.convertTo(K, CV_64F);
+        params.D.reshape(1, (int) params.D.total()).convertTo(D, CV_64F);
+        double k[8] = {0};
+        for (int i = 0; i < min(8, D.rows); i++)
+            k[i] = D.at<double>(i);
+        const double fx = K.at<double>(0, 0), fy = K.at<double>(1, 1);
+        const double cx = K.at<double>(0, 2), cy = K.at<double>(1, 2);
+
+        std::vector<double> squaredErrors(views);
+        cv::parallel_for_(cv::Range(0, views), [&](const cv::Range &range) {
+            for (int i = range.start; i < range.end; i++) {
+                cv::Mat rvec, Rm, tvec;
+                params.R[i].reshape(1, 3).convertTo(rvec, CV_64F);
+                params.T[i].reshape(1, 3).convertTo(tvec, CV_64F);
+                cv::Rodrigues(rvec, Rm);
+                const cv::Matx33d R = Rm;
+                const cv::Vec3d t(tvec.at<double>(0), tvec.at<double>(1), tvec.at<double>(2));
+
+                const auto n = (int) objectPoints[i].size();
+                const cv::Point3f *P = objectPoints[i].data();
+                const cv::Point2f *p = imagePoints[i].data();
+                residuals[i].resize(n);
+                cv::Point2f *r = residuals[i].data();
+                double sum = 0.0;
+                for (int j = 0; j < n; j++) {
+                    double X = R(0, 0) * P[j].x + R(0, 1) * P[j].y + R(0, 2) * P[j].z + t(0);
+                    double Y = R(1, 0) * P[j].x + R(1, 1) * P[j].y + R(1, 2) * P[j].z + t(1);
+                    double Z = R(2, 0) * P[j].x + R(2, 1) * P[j].y + R(2, 2) * P[j].z + t(2);
+                    double x = X / Z, y = Y / Z;
+                    double r2 = x * x + y * y, r4 = r2 * r2, r6 = r4 * r2;
+                    double radial = (1.0 + k[0] * r2 + k[1] * r4 + k[4] * r6) /
+                                    (1.0 + k[5] * r2 + k[6] * r4 + k[7] * r6);
+                    double xd = x * radial + 2.0 * k[2] * x * y + k[3] * (r2 + 2.0 * x * x);
+                    double yd = y * radial + k[2] * (r2 + 2.0 * y * y) + 2.0 * k[3] * x * y;
+                    auto du = (float) (p[j].x - (fx * xd + cx));
+                    auto dv = (float) (p[j].y - (fy * yd + cy));
+                    r[j] = cv::Point2f(du, dv);
+                    sum += (double) du * du + (double) dv * dv;
+                }
+                squaredErrors[i] = sum;
+                perViewErrors[i] = std::sqrt(sum / max(1, n));
+            }
+        });
 
-        return std::sqrt(totalErr / totalPoints); // calculate the arithmetical mean
+        double totalErr = 0.0;
+        int totalPoints = 0;
+        for (int i = 0; i < views; i++) {
+            totalErr += squaredErrors[i];
+            totalPoints += (int) objectPoints[i].size();
+        }
+        return std::sqrt(totalErr / max(1, totalPoints));
     }
 
-    void Calibrator::calibrateCameraBG(const std::vector<ccalib::Snapshot> &instances, ccalib::CalibrationParameters &params,
-                                  std::vector<double> &errs) {
-        std::thread t(&Calibrator::calibrateCamera, this, std::ref(instances), std::ref(params), std::ref(errs));
-        t.detach();
+    /**
+     * Calibrates the camera over all snapshots. In incremental mode the
+     * previous solution seeds the joint refinement: K/D and the poses of the
+     * views solved before are reused, only the pose of new views is
+     * estimated by PnP. cv::calibrateCamera can't take poses as a guess, so
+     * warm starts always run on the sparse solver, with the same camera
+     * model. The OpenCV solver only does the cold starts.
+     */
+    bool Calibrator::calibrateCamera(const std::vector<ccalib::CalibrationView> &views, const cv::Size &imageSize,
+                                     ccalib::CalibrationParameters &params, std::vector<double> &errs) {
+        std::vector<std::vector<cv::Point2f>> residuals;
+        return calibrateCamera(views, imageSize, params, errs, residuals);
     }
 
-    bool Calibrator::calibrateCamera(const std::vector<ccalib::Snapshot> &instances, ccalib::CalibrationParameters &params,
-                                std::vector<double> &errs) {
+    bool Calibrator::calibrateCamera(const std::vector<ccalib::CalibrationView> &views, const cv::Size &imageSize,
+                                     ccalib::CalibrationParameters &params, std::vector<double> &errs,
+                                     std::vector<std::vector<cv::Point2f>> &residuals) {
         // Initialize values
-        busy = true;
         std::vector<cv::Point3f> corners3d;
-        std::vector<ccalib::Snapshot> instancesCopy(instances);
         for (int i = 0; i < checkerboardRows - 1; ++i)
             for (int j = 0; j < checkerboardCols - 1; ++j)
                 corners3d.emplace_back(j * checkerboardSize, i * checkerboardSize, 0);
 
         std::vector<std::vector<cv::Point2f>> imgPoints;
-        std::vector<std::vector<cv::Point3f>> objPoints;
-        for (const auto &instance : instancesCopy) {
-            imgPoints.push_back(instance.corners);
-            objPoints.push_back(corners3d);
-        }
-
-        const int camera_width = instancesCopy[0].img.data.cols;
-        const int camera_height = instancesCopy[0].img.data.rows;
+        std::vector<std::vector<cv::Point3f>> objPoints(views.size(), corners3d);
+        for (const auto &view : views)
+            imgPoints.push_back(view.corners);
 
-        cv::calibrateCamera(objPoints, imgPoints, cv::Size(camera_width, camera_height),
-                            params.K, params.D, params.R, params.T,
-                            CV_CALIB_FIX_ASPECT_RATIO | CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5);
+        // Only the sparse solver can start from the previous poses
+        bool warmStart = canWarmStart(views, imageSize, params);
+        if (solver == SOLVER_SPARSE || warmStart) {
+            if (warmStart)
+                initializeViews(objPoints, views, params);
+            BundleAdjuster adjuster(objPoints, imgPoints);
+            adjuster.solve(imageSize, params.K, params.D, params.R, params.T, warmStart);
+        } else {
+            int flags = cv::CALIB_FIX_ASPECT_RATIO | cv::CALIB_FIX_K4 | cv::CALIB_FIX_K5;
+            cv::TermCriteria criteria(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, 30, DBL_EPSILON);
+            cv::calibrateCamera(objPoints, imgPoints, imageSize, params.K, params.D, params.R, params.T, flags,
+                                criteria);
+        }
 
-        params.reprojErr = computeReprojectionErrors(objPoints, imgPoints, params, errs);
+        params.imageSize = imageSize;
+        params.viewIds.clear();
+        for (const auto &view : views)
+            params.viewIds.push_back(view.id);
+        params.reprojErr = computeReprojectionErrors(objPoints, imgPoints, params, errs, residuals);
         params.reprojErrVar = stddev(errs);
-        busy = false;
         return params.reprojErr <= 0.3f && params.reprojErrVar <= 0.1f;
     }
 
+    /**
+     * A previous solution is only a valid guess for the same camera mode and
+     * if it is not degenerate. Removed views are fine, their poses are dropped.
+     */
+    bool Calibrator::canWarmStart(const std::vector<ccalib::CalibrationView> &views, const cv::Size &imageSize,
+                                  const ccalib::CalibrationParameters &params) {
+        if (!incremental || params.viewIds.empty() || params.reprojErr == DBL_MAX || views.empty() ||
+            params.imageSize != imageSize)
+            return false;
+        return cv::checkRange(params.K) && cv::checkRange(params.D) && params.K.at<double>(0, 0) > 0.0;
+    }
+
+    /**
+     * Aligns the per view poses to the given snapshots. Poses of views
+     * solved before are reused, new views are located by PnP with the
+     * current intrinsics.
+     */
+    void Calibrator::initializeViews(const std::vector<std::vector<cv::Point3f>> &objectPoints,
+                                     const std::vector<ccalib::CalibrationView> &views,
+                                     ccalib::CalibrationParameters &params) {
+        std::map<int, int> known;
+        for (int i = 0; i < (int) params.viewIds.size() && i < (int) params.R.size(); i++)
+            known[params.viewIds[i]] = i;
+
+        std::vector<cv::Mat> R(views.size()), T(views.size());
+        for (size_t i = 0; i < views.size(); i++) {
+            auto it = known.find(views[i].id);
+            if (it != known.end()) {
+                R[i] = params.R[it->second].clone();
+                T[i] = params.T[it->second].clone();
+            } else
+                cv::solvePnP(objectPoints[i], views[i].corners, params.K, params.D, R[i], T[i]);
+        }
+        params.R = R;
+        params.T = T;
+        params.viewIds.clear();
+        for (const auto &view : views)
+            params.viewIds.push_back(view.id);
+    }
+
     double Calibrator::stddev(std::vector<double> const &func) {
         double mean = std::accumulate(func.begin(), func.end(), 0.0) / func.size();
         double sq_sum = std::inner_product(func.begin(), func.end(), func.begin(), 0.0,
@@ -5,21 +5,34 @@
 #ifndef CALIBRATION_H
 #define CALIBRATION_H
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <opencv2/opencv.hpp>
+#include "detectors.h"
 #include "structures.h"
 
 namespace ccalib {
 
+    typedef std::chrono::steady_clock::time_point Deadline;
+
     class Calibrator {
     private:
-        bool busy = false;
+        DetectorBackend backend = DETECTOR_CLASSIC;
+        std::shared_ptr<CheckerboardDetector> detector;
+        std::vector<DetectorStats> detectorStats;
+
+        int refinementWindow(const std::vector<cv::Point2f> &corners);
 
     public:
 
         int checkerboardRows;
         int checkerboardCols;
         float checkerboardSize; // in [m]
+        int searchWidth = 640; // in [px], width of the pyramid level searched first
+        bool incremental = true; // warm start from the previous calibration, always refined by the sparse solver
+        CalibrationSolver solver = SOLVER_OPENCV;
 
         Calibrator();
 
@@ -27,17 +40,40 @@ namespace ccalib {
 
         ~Calibrator();
 
-        bool isCalibrating();
+        void setDetector(const DetectorBackend &detectorBackend);
+
+        DetectorBackend getDetector() const;
+
+        const std::vector<DetectorStats> &getDetectorStats() const;
+
+        void resetDetectorStats();
 
-        bool findCorners(cv::Mat &img, std::vector<cv::Point2f> &corners);
+        bool findCorners(const cv::Mat &img, std::vector<cv::Point2f> &corners);
+
+        DetectionStatus findCorners(const cv::Mat &img, std::vector<cv::Point2f> &corners, const Deadline &deadline,
+                                    DetectionDiagnostics &diagnostics, const std::atomic<bool> *cancel = nullptr);
 
         double computeReprojectionErrors(const std::vector<std::vector<cv::Point3f>> &objectPoints,
                                      const std::vector<std::vector<cv::Point2f>> &imagePoints,
                                      const CalibrationParameters &params, std::vector<double> &perViewErrors);
 
-        bool calibrateCamera(const std::vector<Snapshot> &instances, CalibrationParameters &params, std::vector<double> &errs);
+        double computeReprojectionErrors(const std::vector<std::vector<cv::Point3f>> &objectPoints,
+                                         const std::vector<std::vector<cv::Point2f>> &imagePoints,
+                                         const CalibrationParameters &params, std::vector<double> &perViewErrors,
+                                         std::vector<std::vector<cv::Point2f>> &residuals);
+
+        bool calibrateCamera(const std::vector<CalibrationView> &views, const cv::Size &imageSize,
+                             CalibrationParameters &params, std::vector<double> &errs);
+
+        bool calibrateCamera(const std::vector<CalibrationView> &views, const cv::Size &imageSize,
+                             CalibrationParameters &params, std::vector<double> &errs,
+                             std::vector<std::vector<cv::Point2f>> &residuals);
+
+        bool canWarmStart(const std::vector<CalibrationView> &views, const cv::Size &imageSize,
+                          const CalibrationParameters &params);
 
-        void calibrateCameraBG(const std::vector<Snapshot> &instances, CalibrationParameters &params, std::vector<double> &errs);
+        void initializeViews(const std::vector<std::vector<cv::Point3f>> &objectPoints,
+                             const std::vector<CalibrationView> &views, CalibrationParameters &params);
 
         double stddev(std::vector<double> const & func);
 
@@ -3,12 +3,14 @@
 //
 
 #include "camera.h"
+#include "profiler.h"
 
 #include <iostream>
 #include <string>
 #include <stdio.h>
 
 #include <opencv2/opencv.hpp>
+#include <chrono>
 #include <thread>
 
 
@@ -21,6 +23,8 @@ using namespace std;
  * =====================================================================
  * Let's the user create a new device and continously grab frames from
  * the specified camera in the background.
+ * Alternatively captures through the native V4L2 mmap backend, which
+ * hands out the dequeued driver buffers without copying or decoding.
  * =====================================================================
  */
 
@@ -47,6 +51,7 @@ namespace ccalib {
     Camera::Camera(const string &device_address, const ccalib::CameraParameters &camParams) {
         device = device_address;
         params = camParams;
+        decodeOnDemand = params.decodeOnDemand;
     }
 
     Camera::~Camera() {
@@ -56,7 +61,11 @@ namespace ccalib {
 
     void Camera::open() {
         // Open camera connection
-        camera.open(device);
+        backend = params.backend;
+        if (backend == CAPTURE_V4L2_MMAP)
+            v4l2.open(device);
+        else
+            camera.open(device);
         if (!isOpened())
             printf("Camera %s could not be opened!", device.c_str());
 
@@ -71,6 +80,8 @@ namespace ccalib {
     }
 
     bool Camera::isOpened() {
+        if (backend == CAPTURE_V4L2_MMAP)
+            return v4l2.isOpened();
         return camera.isOpened();
     }
 
@@ -79,22 +90,38 @@ namespace ccalib {
     }
 
     void Camera::updateParameters() {
-        if (isOpened() && !streamOn) {
+        if (isOpened() && !streamOn && backend == CAPTURE_V4L2_MMAP) {
             // Set new params
-            camera.set(CV_CAP_PROP_FOURCC, fourcc(params.format.c_str()));
-            camera.set(CV_CAP_PROP_FPS, params.fps);
-            camera.set(CV_CAP_PROP_FRAME_WIDTH, params.width);
-            camera.set(CV_CAP_PROP_FRAME_HEIGHT, params.height);
-            camera.set(CV_CAP_PROP_AUTO_EXPOSURE, params.autoExposure ? 0.75 : 0.25);
-            camera.set(CV_CAP_PROP_EXPOSURE, params.exposure);
+            v4l2.setRingSize(max(MIN_RING_SIZE, params.ringSize));
+            v4l2.setFormat(fourcc(params.format.c_str()), params.width, params.height);
+            v4l2.setFramerate(params.fps);
+            v4l2.setExposure(params.autoExposure, params.exposure);
 
             // Update with actual settings
-            auto fourcc = static_cast<uint32_t>(camera.get(CV_CAP_PROP_FOURCC));
+            uint32_t fourcc = v4l2.getFormat();
             params.format = cv::format("%c%c%c%c", fourcc & 255, (fourcc >> 8) & 255, (fourcc >> 16) & 255, (fourcc >> 24) & 255);
-            params.fps = (int) camera.get(CV_CAP_PROP_FPS);
-            params.width = (int) camera.get(CV_CAP_PROP_FRAME_WIDTH);
-            params.height = (int) camera.get(CV_CAP_PROP_FRAME_HEIGHT);
-            params.exposure = (float) camera.get(CV_CAP_PROP_EXPOSURE);
+            params.fps = v4l2.getFramerate();
+            params.width = v4l2.getWidth();
+            params.height = v4l2.getHeight();
+            params.exposure = v4l2.getExposure();
+            params.ratio = (float) params.width / params.height;
+            params.ringSize = v4l2.getRingSize();
+        } else if (isOpened() && !streamOn) {
+            // Set new params
+            camera.set(cv::CAP_PROP_FOURCC, fourcc(params.format.c_str()));
+            camera.set(cv::CAP_PROP_FPS, params.fps);
+            camera.set(cv::CAP_PROP_FRAME_WIDTH, params.width);
+            camera.set(cv::CAP_PROP_FRAME_HEIGHT, params.height);
+            camera.set(cv::CAP_PROP_AUTO_EXPOSURE, params.autoExposure ? 0.75 : 0.25);
+            camera.set(cv::CAP_PROP_EXPOSURE, params.exposure);
+
+            // Update with actual settings
+            auto fourcc = static_cast<uint32_t>(camera.get(cv::CAP_PROP_FOURCC));
+            params.format = cv::format("%c%c%c%c", fourcc & 255, (fourcc >> 8) & 255, (fourcc >> 16) & 255, (fourcc >> 24) & 255);
+            params.fps = (int) camera.get(cv::CAP_PROP_FPS);
+            params.width = (int) camera.get(cv::CAP_PROP_FRAME_WIDTH);
+            params.height = (int) camera.get(cv::CAP_PROP_FRAME_HEIGHT);
+            params.exposure = (float) camera.get(cv::CAP_PROP_EXPOSURE);
             params.ratio = (float) params.width / params.height;
         } else if (isOpened()) {
             stopStream();
@@ -109,6 +136,7 @@ namespace ccalib {
 
     void Camera::updateParameters(ccalib::CameraParameters &newParams) {
         params = newParams;
+        decodeOnDemand = params.decodeOnDemand;
         updateParameters();
     }
 
@@ -119,7 +147,10 @@ namespace ccalib {
 
     void Camera::updateExposure(const float &exposure) {
         params.exposure = exposure;
-        camera.set(CV_CAP_PROP_EXPOSURE, params.exposure);
+        if (backend == CAPTURE_V4L2_MMAP)
+            v4l2.setExposure(params.autoExposure, params.exposure);
+        else
+            camera.set(cv::CAP_PROP_EXPOSURE, params.exposure);
     }
 
     void Camera::updateFormat(const string &format) {
@@ -127,6 +158,29 @@ namespace ccalib {
         updateParameters();
     }
 
+    void Camera::updateBackend(const CaptureBackend &captureBackend, const int &ringSize) {
+        params.backend = captureBackend;
+        params.ringSize = max(MIN_RING_SIZE, ringSize);
+
+        // The ring only exists with native capture
+        bool ringChanged = captureBackend == CAPTURE_V4L2_MMAP && v4l2.getRingSize() != params.ringSize;
+        if (isOpened() && (backend != captureBackend || ringChanged)) {
+            // Reopen device with the new backend
+            bool streaming = streamOn;
+            stopStream();
+            close();
+            open();
+            if (streaming)
+                startStream();
+        }
+    }
+
+    void Camera::updateDecodeOnDemand(const bool &onDemand) {
+        params.decodeOnDemand = onDemand;
+        decodeOnDemand = onDemand;
+        frameRequested = true;
+    }
+
     void Camera::updateResolution(const int &width, const int &height) {
         params.width = width;
         params.height = height;
@@ -138,54 +192,234 @@ namespace ccalib {
         return params.ratio;
     }
 
+    /**
+     * Id of the latest frame published by the capture thread.
+     * Restarts from zero whenever the camera is opened.
+     */
     int Camera::getFrameCount() {
         return frameCount;
     }
 
+    /**
+     * Number of frames published by the capture thread so far. Unlike the
+     * frame ids this never restarts, so a newer frame is available whenever
+     * it differs from the value read before the last capture.
+     */
+    uint64_t Camera::getSequence() {
+        return frames.getSequence();
+    }
+
     void Camera::close() {
-        while (streamOn) {
-            streamFlag = false;
-        }
-        while (isOpened())
+        stopStream();
+        if (backend == CAPTURE_V4L2_MMAP)
+            v4l2.close();
+        while (camera.isOpened())
             camera.release();
     }
 
     void Camera::grab() {
-        // TODO only decode needed images to make code more efficient
-        while (streamFlag) {
+        int grabCount = frameCount;
+        while (streamFlag && backend == CAPTURE_V4L2_MMAP) {
+            cv::Mat frame;
+            int index = v4l2.dequeue(frame, 100);
+            if (index >= 0) {
+                // Return the buffer of the recycled slot to the ring before reusing it
+                RawFrame &slot = frames.writeBuffer();
+                v4l2.enqueue(slot.buffer);
+                slot.data = frame;
+                slot.buffer = index;
+                slot.id = ++grabCount;
+                frames.publish();
+                frameCount = slot.id;
+            }
+        }
+
+        // Keep the driver queue drained, but only decode frames which have been requested
+        while (streamFlag && backend == CAPTURE_OPENCV) {
             if (camera.grab()) {
-                camera.retrieve(image);
-                frameCount++;
+                grabCount++;
+                if (!decodeOnDemand || frameRequested.exchange(false)) {
+                    RawFrame &slot = frames.writeBuffer();
+                    camera.retrieve(slot.data);
+                    slot.id = grabCount;
+                    frames.publish();
+                    frameCount = slot.id;
+                }
             }
         }
         streamOn = false;
     }
 
+    /**
+     * Converts a raw frame of the active capture backend into RGB.
+     * OpenCV frames are already decoded to BGR, V4L2 frames are still in
+     * the native pixel format of the device.
+     *
+     * @param raw frame as captured
+     * @param destination cv::Mat to hold the RGB image
+     */
+    void Camera::convertFrame(const cv::Mat &raw, cv::Mat &destination) {
+        if (backend == CAPTURE_OPENCV) {
+            cv::cvtColor(raw, destination, cv::COLOR_BGR2RGB);
+            return;
+        }
+
+        cv::Mat temp;
+        switch (v4l2.getFormat()) {
+            case V4L2_PIX_FMT_YUYV:
+                cv::cvtColor(raw, destination, cv::COLOR_YUV2RGB_YUY2);
+                break;
+            case V4L2_PIX_FMT_GREY:
+                cv::cvtColor(raw, destination, cv::COLOR_GRAY2RGB);
+                break;
+            case V4L2_PIX_FMT_Y16:
+                raw.convertTo(temp, CV_8U, 1.0 / 256.0);
+                cv::cvtColor(temp, destination, cv::COLOR_GRAY2RGB);
+                break;
+            case V4L2_PIX_FMT_RGB24:
+                raw.copyTo(destination);
+                break;
+            case V4L2_PIX_FMT_BGR24:
+                cv::cvtColor(raw, destination, cv::COLOR_BGR2RGB);
+                break;
+            case V4L2_PIX_FMT_MJPEG:
+                temp = cv::imdecode(raw, cv::IMREAD_COLOR);
+                if (!temp.empty()) {
+                    cv::cvtColor(temp, destination, cv::COLOR_BGR2RGB);
+                    break;
+                }
+                // fall through
+            default:
+                destination = cv::Mat::zeros(params.height, params.width, CV_8UC3);
+        }
+    }
+
+    /**
+     * Extracts the luminance of a raw frame of the active capture backend.
+     * Y plane formats are only copied out of the driver buffer, MJPEG frames
+     * are decoded straight to grayscale.
+     *
+     * @param raw frame as captured
+     * @param destination cv::Mat to hold the 8-bit gray image
+     */
+    void Camera::convertGray(const cv::Mat &raw, cv::Mat &destination) {
+        if (backend == CAPTURE_OPENCV) {
+            if (raw.channels() == 1)
+                raw.copyTo(destination);
+            else
+                cv::cvtColor(raw, destination, cv::COLOR_BGR2GRAY);
+            return;
+        }
+
+        switch (v4l2.getFormat()) {
+            case V4L2_PIX_FMT_YUYV:
+                cv::extractChannel(raw, destination, 0);
+                break;
+            case V4L2_PIX_FMT_GREY:
+                raw.copyTo(destination);
+                break;
+            case V4L2_PIX_FMT_Y16:
+                raw.convertTo(destination, CV_8U, 1.0 / 256.0);
+                break;
+            case V4L2_PIX_FMT_RGB24:
+                cv::cvtColor(raw, destination, cv::COLOR_RGB2GRAY);
+                break;
+            case V4L2_PIX_FMT_BGR24:
+                cv::cvtColor(raw, destination, cv::COLOR_BGR2GRAY);
+                break;
+            case V4L2_PIX_FMT_MJPEG:
+                destination = cv::imdecode(raw, cv::IMREAD_GRAYSCALE);
+                if (!destination.empty())
+                    break;
+                // fall through
+            default:
+                destination = cv::Mat::zeros(params.height, params.width, CV_8UC1);
+        }
+    }
+
     /**
      * Retrieves the latest frame by reference.
      * If the camera is not streaming or the image is empty,
      * a black frame will be returned instead.
-     * Also returns the frameCount.
+     * Also returns the id of the retrieved frame.
+     * Frames are handed over through a triple buffer, so the capture
+     * thread can keep writing while the frame is being converted.
+     * In decode on demand mode the frame is requested first, this blocks
+     * for at most two frame periods until it has been decoded.
      *
      * @param destination cv::Mat to hold the image
-     * @return frameCount or -1 if image is empty
+     * @return frame id or -1 if image is empty
      */
     int Camera::captureFrame(cv::Mat &destination) {
+        ScopedTimer timer("Capture");
         // Retrieve latest frame if camera is streaming, else return black frame
-        if (streamOn && !image.empty()) {
-            cv::cvtColor(image, destination, cv::COLOR_BGR2RGB);
-            return frameCount;
+        fetchFrame();
+        const RawFrame &frame = frames.readBuffer();
+        if (streamOn && !frame.data.empty()) {
+            convertFrame(frame.data, destination);
+            return frame.id;
         } else {
             destination = cv::Mat::zeros(params.height, params.width, CV_8UC3);
             return -1;
         }
     }
 
+    /**
+     * Retrieves the luminance of the latest frame by reference.
+     * Behaves like captureFrame(), but skips any colour conversion.
+     *
+     * @param destination cv::Mat to hold the gray image
+     * @return frame id or -1 if image is empty
+     */
+    int Camera::captureGray(cv::Mat &destination) {
+        ScopedTimer timer("Capture");
+        // Retrieve latest frame if camera is streaming, else return black frame
+        fetchFrame();
+        const RawFrame &frame = frames.readBuffer();
+        if (streamOn && !frame.data.empty()) {
+            convertGray(frame.data, destination);
+            return frame.id;
+        } else {
+            destination = cv::Mat::zeros(params.height, params.width, CV_8UC1);
+            return -1;
+        }
+    }
+
+    /**
+     * Makes the latest published frame the read buffer. In decode on demand
+     * mode a frame is only decoded once requested, so request it and wait
+     * for it first. Otherwise the returned frame would be the one requested
+     * by the previous capture, one capture late.
+     */
+    void Camera::fetchFrame() {
+        if (decodeOnDemand && backend == CAPTURE_OPENCV && streamOn) {
+            uint64_t sequence = frames.getSequence();
+            requestFrame();
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2000 / max(1, params.fps));
+            while (streamOn && frames.getSequence() == sequence && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        frames.update();
+    }
+
+    /**
+     * Asks the capture thread to decode the next grabbed frame.
+     * Only has an effect in decode on demand mode, otherwise every frame
+     * is decoded anyways. Native V4L2 frames are always decoded lazily
+     * by captureFrame().
+     */
+    void Camera::requestFrame() {
+        frameRequested = true;
+    }
+
     void Camera::startStream() {
         // Activate streaming
+        if (backend == CAPTURE_V4L2_MMAP && !v4l2.startStream())
+            return;
         if (isOpened()) {
             streamOn = true;
             streamFlag = true;
+            frameRequested = true;
             std::thread t(&Camera::grab, this);
             t.detach();
         }
@@ -196,6 +430,11 @@ namespace ccalib {
         while (streamOn) {
             streamFlag = false;
         }
+
+        // Drop the buffer headers before the mapping goes away
+        frames.reset();
+        if (backend == CAPTURE_V4L2_MMAP)
+            v4l2.stopStream();
     }
 
     constexpr uint32_t Camera::fourcc(char const p[5]) {
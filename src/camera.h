@@ -5,26 +5,45 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <atomic>
 #include <string>
 #include <linux/videodev2.h>
 #include <opencv2/opencv.hpp>
 #include <thread>
 #include "structures.h"
+#include "triple_buffer.h"
+#include "v4l2_capture.h"
 
 namespace ccalib {
 
+    struct RawFrame {
+        cv::Mat data;
+        int id = 0;
+        int buffer = -1;
+    };
+
     class Camera {
     private:
-        bool streamOn = false;
-        bool streamFlag = false;
-        int frameCount = 0;
+        std::atomic<bool> streamOn{false};
+        std::atomic<bool> streamFlag{false};
+        std::atomic<int> frameCount{0};
+        std::atomic<bool> frameRequested{true};
+        std::atomic<bool> decodeOnDemand{false};
 
         std::string device = "/dev/video0";
+        ccalib::CaptureBackend backend = CAPTURE_OPENCV;
         cv::VideoCapture camera;
-        cv::Mat image;
+        ccalib::V4L2Capture v4l2;
+        ccalib::TripleBuffer<RawFrame> frames;
 
         ccalib::CameraParameters params;
 
+        void convertFrame(const cv::Mat &raw, cv::Mat &destination);
+
+        void convertGray(const cv::Mat &raw, cv::Mat &destination);
+
+        void fetchFrame();
+
     public:
 
         Camera();
@@ -51,6 +70,10 @@ namespace ccalib {
 
         int captureFrame(cv::Mat &destination);
 
+        int captureGray(cv::Mat &destination);
+
+        void requestFrame();
+
         void updateResolution(const int &width, const int &height);
 
         void updateExposure(const float &exposure);
@@ -59,6 +82,10 @@ namespace ccalib {
 
         void updateFormat(const std::string &format);
 
+        void updateBackend(const CaptureBackend &captureBackend, const int &ringSize = MIN_RING_SIZE);
+
+        void updateDecodeOnDemand(const bool &onDemand);
+
         void updateParameters(CameraParameters &newParams);
 
         bool isOpened();
@@ -72,6 +99,8 @@ namespace ccalib {
         void open(const std::string &device_address);
 
         int getFrameCount();
+
+        uint64_t getSequence();
     };
 
 } // namespace ccalib
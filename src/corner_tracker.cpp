@@ -0,0 +1,133 @@
+#include "corner_tracker.h"
+
+#include <numeric>
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Checkerboard Corner Tracking
+ * =====================================================================
+ * Propagates the last detected corner set to the next frame with
+ * pyramidal Lucas-Kanade optical flow. The tracked grid is only accepted
+ * if every corner tracks forward and backward consistently and the grid
+ * still fits a homography of the ideal board with the same orientation.
+ * A full detection is required after refreshInterval tracked frames.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    CornerTracker::CornerTracker() {}
+
+    CornerTracker::~CornerTracker() {}
+
+    bool CornerTracker::isTracking() {
+        return !previousCorners.empty();
+    }
+
+    void CornerTracker::reset() {
+        previousImage.release();
+        previousCorners.clear();
+        framesSinceDetection = 0;
+    }
+
+    /**
+     * Sets a new reference after a successful full detection.
+     *
+     * @param gray image the corners have been detected on
+     * @param pattern inner corners per row and column
+     * @param corners detected corners
+     */
+    void CornerTracker::update(const cv::Mat &gray, const cv::Size &pattern, const std::vector<cv::Point2f> &corners) {
+        previousImage = gray;
+        previousCorners = corners;
+        patternSize = pattern;
+        framesSinceDetection = 0;
+    }
+
+    /**
+     * Tracks the previous corner set into the given frame.
+     *
+     * @param gray image to track into, needs the size of the previous image
+     * @param pattern inner corners per row and column
+     * @param corners tracked corners
+     * @return true if tracking succeeded, else a full detection is needed
+     */
+    bool CornerTracker::track(const cv::Mat &gray, const cv::Size &pattern, std::vector<cv::Point2f> &corners) {
+        if (previousCorners.empty() || pattern != patternSize || gray.size() != previousImage.size() ||
+            framesSinceDetection >= refreshInterval)
+            return false;
+
+        // Track forward and back again to reject drifting corners
+        std::vector<cv::Point2f> backtracked;
+        std::vector<uchar> status, statusBack;
+        std::vector<float> err;
+        const cv::Size window(21, 21);
+        cv::calcOpticalFlowPyrLK(previousImage, gray, previousCorners, corners, status, err, window, 3);
+        cv::calcOpticalFlowPyrLK(gray, previousImage, corners, backtracked, statusBack, err, window, 3);
+
+        const cv::Rect2f bounds(0, 0, gray.cols, gray.rows);
+        for (size_t i = 0; i < corners.size(); i++) {
+            if (!status[i] || !statusBack[i] || !bounds.contains(corners[i]) ||
+                cv::norm(backtracked[i] - previousCorners[i]) > maxFlowError) {
+                reset();
+                return false;
+            }
+        }
+
+        if (!validateGrid(corners)) {
+            reset();
+            return false;
+        }
+
+        // Lock onto the actual saddle points
+        cv::cornerSubPix(gray, corners, cv::Size(5, 5), cv::Size(-1, -1),
+                         cv::TermCriteria(cv::TermCriteria::EPS | cv::TermCriteria::COUNT, 10, 0.1));
+
+        previousImage = gray;
+        previousCorners = corners;
+        framesSinceDetection++;
+        return true;
+    }
+
+    bool CornerTracker::validateGrid(const std::vector<cv::Point2f> &corners) {
+        // Ideal board in units of squares
+        std::vector<cv::Point2f> ideal;
+        for (int i = 0; i < patternSize.height; i++)
+            for (int j = 0; j < patternSize.width; j++)
+                ideal.emplace_back(j, i);
+
+        cv::Mat H = cv::findHomography(ideal, corners, 0);
+        if (H.empty())
+            return false;
+
+        // Homography residual relative to the mean square spacing
+        std::vector<cv::Point2f> projected;
+        cv::perspectiveTransform(ideal, projected, H);
+        double residual = 0.0, spacing = 0.0;
+        int neighbours = 0;
+        for (size_t i = 0; i < corners.size(); i++) {
+            residual += pow(cv::norm(projected[i] - corners[i]), 2);
+            if ((i + 1) % patternSize.width) {
+                spacing += cv::norm(corners[i + 1] - corners[i]);
+                neighbours++;
+            }
+        }
+        residual = sqrt(residual / corners.size());
+        spacing /= max(1, neighbours);
+        if (residual > maxResidual * spacing)
+            return false;
+
+        // Grid must not have flipped its orientation
+        auto orientation = [this](const std::vector<cv::Point2f> &c) {
+            cv::Point2f row = c[patternSize.width - 1] - c[0];
+            cv::Point2f diagonal = c[c.size() - 1] - c[0];
+            return row.cross(diagonal) > 0;
+        };
+        return orientation(corners) == orientation(previousCorners);
+    }
+
+} // namespace ccalib
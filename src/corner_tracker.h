@@ -0,0 +1,39 @@
+#ifndef CORNER_TRACKER_H
+#define CORNER_TRACKER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace ccalib {
+
+    class CornerTracker {
+    private:
+        cv::Mat previousImage;
+        std::vector<cv::Point2f> previousCorners;
+        cv::Size patternSize;
+        int framesSinceDetection = 0;
+
+        bool validateGrid(const std::vector<cv::Point2f> &corners);
+
+    public:
+
+        int refreshInterval = 15;    // frames until a full detection is forced
+        float maxFlowError = 0.5f;   // in [px], forward-backward tracking error
+        float maxResidual = 0.1f;    // homography residual relative to the square spacing
+
+        CornerTracker();
+
+        ~CornerTracker();
+
+        bool track(const cv::Mat &gray, const cv::Size &pattern, std::vector<cv::Point2f> &corners);
+
+        void update(const cv::Mat &gray, const cv::Size &pattern, const std::vector<cv::Point2f> &corners);
+
+        void reset();
+
+        bool isTracking();
+    };
+
+} // namespace ccalib
+
+#endif // CORNER_TRACKER_H
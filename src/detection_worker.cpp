@@ -0,0 +1,231 @@
+#include "detection_worker.h"
+#include "functions.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Asynchronous Checkerboard Detection
+ * =====================================================================
+ * Runs the checkerboard detection on a dedicated thread. Only the
+ * newest submitted frame is kept, stale frames are dropped while the
+ * worker is busy. Results are published through a triple buffer, so
+ * the UI never waits on a detection in progress.
+ * Every frame gets a time budget starting at submission, so the
+ * latency of the live path stays bounded.
+ * Between full detections the corners are tracked by optical flow.
+ * Full detections are limited to the ROI predicted from the motion of
+ * the checkerboard frame. Without a prediction, a cheap presence test
+ * skips frames without a checkerboard and narrows the ROI. The detector
+ * backend can be switched at runtime, its statistics are published with
+ * every result.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    DetectionWorker::DetectionWorker() {}
+
+    DetectionWorker::~DetectionWorker() {
+        stop();
+    }
+
+    void DetectionWorker::start() {
+        if (running)
+            return;
+        running = true;
+        cancel = false;
+        worker = std::thread(&DetectionWorker::run, this);
+    }
+
+    void DetectionWorker::stop() {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            running = false;
+            cancel = true;
+        }
+        jobCondition.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool DetectionWorker::isRunning() {
+        return running;
+    }
+
+    void DetectionWorker::setBudget(const int &milliseconds) {
+        budget = max(1, milliseconds);
+    }
+
+    int DetectionWorker::getBudget() {
+        return budget;
+    }
+
+    /**
+     * Enables or disables corner tracking. Any toggle drops the tracked
+     * corners and the motion prediction, the worker thread resets them
+     * before its next frame.
+     */
+    void DetectionWorker::setTracking(const bool &enabled) {
+        if (tracking.exchange(enabled) != enabled)
+            trackingToggled = true;
+    }
+
+    bool DetectionWorker::isTracking() {
+        return tracking;
+    }
+
+    void DetectionWorker::setPrefilter(const bool &enabled) {
+        prefilter = enabled;
+    }
+
+    bool DetectionWorker::isPrefiltering() {
+        return prefilter;
+    }
+
+    void DetectionWorker::setDetector(const DetectorBackend &detectorBackend) {
+        if (isDetectorAvailable(detectorBackend))
+            backend = detectorBackend;
+    }
+
+    DetectorBackend DetectionWorker::getDetector() {
+        return (DetectorBackend) backend.load();
+    }
+
+    /**
+     * Queues a frame for detection, replacing any frame which has not been
+     * picked up yet. The image is copied, so the caller can reuse its buffer.
+     *
+     * @param gray 8-bit gray image
+     * @param id frame id reported back with the result
+     * @param calibrator holds the checkerboard dimensions
+     * @param camParams camera parameters of the frame
+     */
+    void DetectionWorker::submit(const cv::Mat &gray, const int &id, const Calibrator &calibrator,
+                                 const CameraParameters &camParams) {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            pendingJob.image = gray.clone();
+            pendingJob.id = id;
+            pendingJob.checkerboardRows = calibrator.checkerboardRows;
+            pendingJob.checkerboardCols = calibrator.checkerboardCols;
+            pendingJob.camParams = camParams;
+            pendingJob.timestamp = std::chrono::steady_clock::now();
+            pendingJob.deadline = pendingJob.timestamp + std::chrono::milliseconds(budget.load());
+            pending = true;
+        }
+        jobCondition.notify_one();
+    }
+
+    /**
+     * Fetches the latest detection result.
+     *
+     * @param result to hold the detection
+     * @return true if a new result has been published since the last poll
+     */
+    bool DetectionWorker::poll(DetectionResult &result) {
+        if (!results.update())
+            return false;
+        result = results.readBuffer();
+        return true;
+    }
+
+    void DetectionWorker::run() {
+        while (running) {
+            DetectionJob job;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobCondition.wait(lock, [this] { return pending || !running; });
+                if (!running)
+                    break;
+                job = std::move(pendingJob);
+                pending = false;
+            }
+
+            // Never validate against corners from before a tracking toggle
+            if (trackingToggled.exchange(false)) {
+                tracker.reset();
+                predictor.reset();
+            }
+
+            calib.setDetector(getDetector());
+            DetectionResult &result = results.writeBuffer();
+            detect(job, result);
+            result.backend = calib.getDetector();
+            result.detectorStats = calib.getDetectorStats();
+            results.publish();
+        }
+    }
+
+    void DetectionWorker::detect(const DetectionJob &job, DetectionResult &result) {
+        calib.checkerboardRows = job.checkerboardRows;
+        calib.checkerboardCols = job.checkerboardCols;
+        result.image = job.image;
+        result.id = job.id;
+        result.corners.clear();
+
+        // Predict where to search next
+        const cv::Size patternSize(job.checkerboardCols - 1, job.checkerboardRows - 1);
+        const cv::Rect fullFrame(0, 0, job.image.cols, job.image.rows);
+        cv::Rect roi = fullFrame;
+        float skewRatio = (float) patternSize.width / patternSize.height;
+        bool predicted = predictor.predict(job.timestamp, job.image.size(), (float) job.image.cols / job.image.rows,
+                                           skewRatio, roi);
+        if (!predicted)
+            roi = fullFrame;
+
+        // Cheap path, propagate previous corners
+        auto start = std::chrono::steady_clock::now();
+        if (tracking && tracker.track(job.image, patternSize, result.corners)) {
+            result.diagnostics = DetectionDiagnostics();
+            result.diagnostics.status = DETECTION_FOUND;
+            result.diagnostics.budget = std::chrono::duration<double, std::milli>(job.deadline - start).count();
+            result.diagnostics.elapsed = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+            result.diagnostics.cornersFound = (int) result.corners.size();
+            result.diagnostics.tracked = true;
+            result.hasCheckerboard = true;
+            calib.computeFrame(result.corners, job.camParams, result.frame, result.frameCorners);
+            predictor.correct(result.frame);
+            return;
+        }
+
+        // Without a prediction, test for presence first
+        if (!predicted && prefilter && !presence.check(job.image, patternSize, roi)) {
+            result.diagnostics = DetectionDiagnostics();
+            result.diagnostics.budget = std::chrono::duration<double, std::milli>(job.deadline - start).count();
+            result.diagnostics.elapsed = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start).count();
+            result.diagnostics.rejected = true;
+            result.hasCheckerboard = false;
+            result.frameCorners.points.clear();
+            tracker.reset();
+            predictor.miss();
+            return;
+        }
+
+        // Search the ROI, scaling is left to the detection pyramid
+        cv::Mat gray;
+        cv::normalize(job.image(roi), gray, 255, 0, cv::NORM_MINMAX);
+
+        // Find corners
+        calib.findCorners(gray, result.corners, job.deadline, result.diagnostics, &cancel);
+        if ((result.hasCheckerboard = result.diagnostics.status == DETECTION_FOUND)) {
+            // Add ROI offset
+            for (auto &p : result.corners) {
+                p.x += roi.x;
+                p.y += roi.y;
+            }
+            calib.computeFrame(result.corners, job.camParams, result.frame, result.frameCorners);
+            tracker.update(job.image, patternSize, result.corners);
+            predictor.correct(result.frame);
+        } else {
+            result.frameCorners.points.clear();
+            tracker.reset();
+            predictor.miss();
+        }
+    }
+
+} // namespace ccalib
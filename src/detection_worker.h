@@ -0,0 +1,90 @@
+#ifndef DETECTION_WORKER_H
+#define DETECTION_WORKER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <opencv2/opencv.hpp>
+#include "calibrator.h"
+#include "corner_tracker.h"
+#include "frame_predictor.h"
+#include "presence_filter.h"
+#include "structures.h"
+#include "triple_buffer.h"
+
+namespace ccalib {
+
+    struct DetectionJob {
+        cv::Mat image;
+        int id = -1;
+        int checkerboardRows = 0;
+        int checkerboardCols = 0;
+        CameraParameters camParams;
+        Deadline timestamp;
+        Deadline deadline;
+    };
+
+    class DetectionWorker {
+    private:
+        std::atomic<bool> running{false};
+        std::atomic<bool> cancel{false};
+        std::atomic<int> budget{50};
+        std::atomic<bool> tracking{true};
+        std::atomic<bool> trackingToggled{false};
+        std::atomic<bool> prefilter{true};
+        std::atomic<int> backend{DETECTOR_CLASSIC};
+        std::thread worker;
+
+        std::mutex jobMutex;
+        std::condition_variable jobCondition;
+        DetectionJob pendingJob;
+        bool pending = false;
+
+        ccalib::Calibrator calib;
+        ccalib::CornerTracker tracker;
+        ccalib::FramePredictor predictor;
+        ccalib::PresenceFilter presence;
+        ccalib::TripleBuffer<DetectionResult> results;
+
+        void run();
+
+        void detect(const DetectionJob &job, DetectionResult &result);
+
+    public:
+
+        DetectionWorker();
+
+        ~DetectionWorker();
+
+        void start();
+
+        void stop();
+
+        void submit(const cv::Mat &gray, const int &id, const Calibrator &calibrator,
+                    const CameraParameters &camParams);
+
+        bool poll(DetectionResult &result);
+
+        bool isRunning();
+
+        void setBudget(const int &milliseconds);
+
+        int getBudget();
+
+        void setTracking(const bool &enabled);
+
+        bool isTracking();
+
+        void setPrefilter(const bool &enabled);
+
+        bool isPrefiltering();
+
+        void setDetector(const DetectorBackend &detectorBackend);
+
+        DetectorBackend getDetector();
+    };
+
+} // namespace ccalib
+
+#endif // DETECTION_WORKER_H
@@ -0,0 +1,80 @@
+#include "detectors.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Checkerboard Detector Backends
+ * =====================================================================
+ * Classic: cv::findChessboardCorners, quad based, fast on sharp images
+ *          but needs a sub-pixel refinement afterwards.
+ * Sector:  cv::findChessboardCornersSB, localized radon transform,
+ *          more robust against blur and noise and sub-pixel accurate
+ *          by itself. Requires OpenCV 3.4.4 or 4.0.0 and later.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    std::string ClassicDetector::name() const {
+        return detectorName(DETECTOR_CLASSIC);
+    }
+
+    bool ClassicDetector::detect(const cv::Mat &gray, const cv::Size &patternSize,
+                                 std::vector<cv::Point2f> &corners) {
+        return cv::findChessboardCorners(gray, patternSize, corners,
+                                         cv::CALIB_CB_ADAPTIVE_THRESH | cv::CALIB_CB_NORMALIZE_IMAGE |
+                                         cv::CALIB_CB_FAST_CHECK);
+    }
+
+    bool ClassicDetector::isSubPixel() const {
+        return false;
+    }
+
+    std::string SectorDetector::name() const {
+        return detectorName(DETECTOR_SECTOR);
+    }
+
+    bool SectorDetector::detect(const cv::Mat &gray, const cv::Size &patternSize,
+                                std::vector<cv::Point2f> &corners) {
+#if CCALIB_HAS_SECTOR_DETECTOR
+        return cv::findChessboardCornersSB(gray, patternSize, corners, cv::CALIB_CB_NORMALIZE_IMAGE);
+#else
+        corners.clear();
+        return false;
+#endif
+    }
+
+    bool SectorDetector::isSubPixel() const {
+        return true;
+    }
+
+    std::shared_ptr<CheckerboardDetector> createDetector(const DetectorBackend &backend) {
+        // Fall back to the classic detector if the backend is not built in
+        if (backend == DETECTOR_SECTOR && isDetectorAvailable(backend))
+            return std::make_shared<SectorDetector>();
+        return std::make_shared<ClassicDetector>();
+    }
+
+    bool isDetectorAvailable(const DetectorBackend &backend) {
+#if CCALIB_HAS_SECTOR_DETECTOR
+        return backend >= 0 && backend < DETECTOR_COUNT;
+#else
+        return backend == DETECTOR_CLASSIC;
+#endif
+    }
+
+    std::string detectorName(const DetectorBackend &backend) {
+        switch (backend) {
+            case DETECTOR_CLASSIC:
+                return "Classic";
+            case DETECTOR_SECTOR:
+                return "Sector";
+            default:
+                return "Unknown";
+        }
+    }
+
+} // namespace ccalib
@@ -0,0 +1,61 @@
+#ifndef DETECTORS_H
+#define DETECTORS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "structures.h"
+
+// cv::findChessboardCornersSB ships with OpenCV 3.4.4 and 4.0.0
+#if CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && (CV_VERSION_MINOR > 4 || \
+    (CV_VERSION_MINOR == 4 && CV_VERSION_REVISION >= 4)))
+#define CCALIB_HAS_SECTOR_DETECTOR 1
+#else
+#define CCALIB_HAS_SECTOR_DETECTOR 0
+#endif
+
+namespace ccalib {
+
+    class CheckerboardDetector {
+    public:
+
+        virtual ~CheckerboardDetector() = default;
+
+        virtual std::string name() const = 0;
+
+        virtual bool detect(const cv::Mat &gray, const cv::Size &patternSize, std::vector<cv::Point2f> &corners) = 0;
+
+        // True if detected corners are already refined on the searched image
+        virtual bool isSubPixel() const = 0;
+    };
+
+    class ClassicDetector : public CheckerboardDetector {
+    public:
+
+        std::string name() const override;
+
+        bool detect(const cv::Mat &gray, const cv::Size &patternSize, std::vector<cv::Point2f> &corners) override;
+
+        bool isSubPixel() const override;
+    };
+
+    class SectorDetector : public CheckerboardDetector {
+    public:
+
+        std::string name() const override;
+
+        bool detect(const cv::Mat &gray, const cv::Size &patternSize, std::vector<cv::Point2f> &corners) override;
+
+        bool isSubPixel() const override;
+    };
+
+    std::shared_ptr<CheckerboardDetector> createDetector(const DetectorBackend &backend);
+
+    bool isDetectorAvailable(const DetectorBackend &backend);
+
+    std::string detectorName(const DetectorBackend &backend);
+
+} // namespace ccalib
+
+#endif // DETECTORS_H
@@ -0,0 +1,124 @@
+#include "frame_predictor.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Checkerboard Frame Motion Prediction
+ * =====================================================================
+ * Constant velocity Kalman filter over the checkerboard frame
+ * (pos, size, skew). Places the detection ROI at the predicted frame
+ * and sizes it by the predicted extent plus its uncertainty. Every
+ * missed detection grows the ROI further until the filter is reset and
+ * the full frame is searched again.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    FramePredictor::FramePredictor() : kalman(8, 4, 0, CV_32F) {
+        kalman.measurementMatrix = cv::Mat::zeros(4, 8, CV_32F);
+        for (int i = 0; i < 4; i++)
+            kalman.measurementMatrix.at<float>(i, i) = 1.0f;
+        cv::setIdentity(kalman.measurementNoiseCov, cv::Scalar::all(measurementNoise * measurementNoise));
+    }
+
+    FramePredictor::~FramePredictor() {}
+
+    bool FramePredictor::isInitialized() {
+        return initialized;
+    }
+
+    void FramePredictor::reset() {
+        initialized = false;
+        misses = 0;
+    }
+
+    void FramePredictor::setTimestep(const double &dt) {
+        // Constant velocity model driven by white noise acceleration
+        auto q = (float) (acceleration * acceleration);
+        auto t = (float) dt;
+        cv::setIdentity(kalman.transitionMatrix);
+        kalman.processNoiseCov = cv::Mat::zeros(8, 8, CV_32F);
+        for (int i = 0; i < 4; i++) {
+            kalman.transitionMatrix.at<float>(i, i + 4) = t;
+            kalman.processNoiseCov.at<float>(i, i) = t * t * t * t / 4.0f * q;
+            kalman.processNoiseCov.at<float>(i, i + 4) = t * t * t / 2.0f * q;
+            kalman.processNoiseCov.at<float>(i + 4, i) = t * t * t / 2.0f * q;
+            kalman.processNoiseCov.at<float>(i + 4, i + 4) = t * t * q;
+        }
+    }
+
+    /**
+     * Predicts the checkerboard frame at the given time and derives the ROI
+     * to search in.
+     *
+     * @param timestamp capture time of the next frame
+     * @param imgSize size of the next frame
+     * @param ratio aspect ratio of the camera
+     * @param skewRatio aspect ratio of the checkerboard
+     * @param roi region to search in
+     * @return false if there is no prior and the full frame needs to be searched
+     */
+    bool FramePredictor::predict(const std::chrono::steady_clock::time_point &timestamp, const cv::Size &imgSize,
+                                 const float &ratio, const float &skewRatio, cv::Rect &roi) {
+        double dt = std::chrono::duration<double>(timestamp - lastUpdate).count();
+        lastUpdate = timestamp;
+        if (!initialized)
+            return false;
+
+        setTimestep(min(max(dt, 0.0), 1.0));
+        cv::Mat state = kalman.predict();
+        auto x = state.at<float>(0), y = state.at<float>(1);
+        auto size = max(state.at<float>(2), 0.01f), skew = state.at<float>(3);
+
+        // Invert the skew measure of Calibrator::computeFrame to get the extent
+        float aspect = exp(3.0f * (skew - 0.5f)) * skewRatio / ratio;
+        float width = size * sqrt(aspect) * imgSize.width;
+        float height = size / sqrt(aspect) * imgSize.height;
+
+        // Board may be rotated, use the circumscribed circle plus border
+        float radius = 0.5f * sqrt(width * width + height * height) + size * imgSize.width * 0.2f;
+
+        // Add prediction uncertainty and grow with every miss
+        const cv::Mat &P = kalman.errorCovPre;
+        float sigmaSize = sigmas * sqrt(P.at<float>(2, 2)) * max(imgSize.width, imgSize.height);
+        float halfWidth = radius + sigmas * sqrt(P.at<float>(0, 0)) * imgSize.width + sigmaSize;
+        float halfHeight = radius + sigmas * sqrt(P.at<float>(1, 1)) * imgSize.height + sigmaSize;
+        auto scale = (float) pow(growth, misses);
+        halfWidth *= scale;
+        halfHeight *= scale;
+
+        cv::Point2f center(x * imgSize.width, y * imgSize.height);
+        roi = cv::Rect(cv::Point((int) (center.x - halfWidth), (int) (center.y - halfHeight)),
+                       cv::Point((int) (center.x + halfWidth), (int) (center.y + halfHeight)));
+        roi &= cv::Rect(0, 0, imgSize.width, imgSize.height);
+        return roi.area() > 0;
+    }
+
+    void FramePredictor::correct(const CheckerboardFrame &frame) {
+        cv::Mat measurement = (cv::Mat_<float>(4, 1) << frame.pos.x, frame.pos.y, frame.size, frame.skew);
+        misses = 0;
+        if (!initialized) {
+            // Start at rest with uncertain velocity
+            kalman.statePost = cv::Mat::zeros(8, 1, CV_32F);
+            measurement.copyTo(kalman.statePost.rowRange(0, 4));
+            kalman.errorCovPost = cv::Mat::zeros(8, 8, CV_32F);
+            for (int i = 0; i < 4; i++) {
+                kalman.errorCovPost.at<float>(i, i) = measurementNoise * measurementNoise;
+                kalman.errorCovPost.at<float>(i + 4, i + 4) = 1.0f;
+            }
+            initialized = true;
+            return;
+        }
+        kalman.correct(measurement);
+    }
+
+    void FramePredictor::miss() {
+        if (++misses > maxMisses)
+            reset();
+    }
+
+} // namespace ccalib
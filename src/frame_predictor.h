@@ -0,0 +1,45 @@
+#ifndef FRAME_PREDICTOR_H
+#define FRAME_PREDICTOR_H
+
+#include <chrono>
+#include <opencv2/opencv.hpp>
+#include "structures.h"
+
+namespace ccalib {
+
+    class FramePredictor {
+    private:
+        cv::KalmanFilter kalman;
+        std::chrono::steady_clock::time_point lastUpdate;
+        bool initialized = false;
+        int misses = 0;
+
+        void setTimestep(const double &dt);
+
+    public:
+
+        float acceleration = 5.0f;    // in [relative units / s^2], expected hand motion
+        float measurementNoise = 0.005f;
+        float sigmas = 3.0f;          // uncertainty added to the search region
+        float growth = 1.5f;          // search region growth per missed detection
+        int maxMisses = 4;            // misses until the full frame is searched
+
+        FramePredictor();
+
+        ~FramePredictor();
+
+        bool predict(const std::chrono::steady_clock::time_point &timestamp, const cv::Size &imgSize,
+                     const float &ratio, const float &skewRatio, cv::Rect &roi);
+
+        void correct(const CheckerboardFrame &frame);
+
+        void miss();
+
+        void reset();
+
+        bool isInitialized();
+    };
+
+} // namespace ccalib
+
+#endif // FRAME_PREDICTOR_H
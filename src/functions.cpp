@@ -9,32 +9,6 @@
 
 namespace ccalib {
 
-    void mat2Texture(cv::Mat &image, GLuint &imageTexture) {
-        if (!image.empty()) {
-            //glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-            glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-            glGenTextures(1, &imageTexture);
-            glBindTexture(GL_TEXTURE_2D, imageTexture);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            // Set texture clamping method
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-            glTexImage2D(GL_TEXTURE_2D,         // Type of texture
-                         0,                   // Pyramid level (for mip-mapping) - 0 is the top level
-                         GL_RGB,              // Internal colour format to convert to
-                         image.cols,          // Image width  i.e. 640 for Kinect in standard mode
-                         image.rows,          // Image height i.e. 480 for Kinect in standard mode
-                         0,                   // Border width in pixels (can either be 1 or 0)
-                         GL_RGB,              // Input image format (i.e. GL_RGB, GL_RGBA, GL_BGR etc.)
-                         GL_UNSIGNED_BYTE,    // Image data type
-                         image.ptr());        // The actual image data itself
-        }
-    }
-
     float computeImageDiff(const cv::Mat &img1, const cv::Mat &img2, cv::Rect &rect) {
         // Assert same dimensionality of images to compare
         assert(img1.size == img2.size && "Images need to have the same dimensions!");
@@ -42,17 +16,20 @@ namespace ccalib {
         // Ensure ROI is inside image boundaries
         rect = rect & cv::Rect(0, 0, img1.cols, img1.rows);
 
-        // Variables to hold clipped images
+        // Variables to hold clipped images, gray images are compared directly
         cv::Mat oldImg = img1(rect);
         cv::Mat newImg = img2(rect);
+        if (oldImg.channels() == 3)
+            cv::cvtColor(oldImg, oldImg, cv::COLOR_RGB2GRAY);
+        if (newImg.channels() == 3)
+            cv::cvtColor(newImg, newImg, cv::COLOR_RGB2GRAY);
 
         // Do comparison
-        cv::cvtColor(oldImg, oldImg, cv::COLOR_RGB2GRAY);
-        cv::cvtColor(newImg, newImg, cv::COLOR_RGB2GRAY);
-        cv::normalize(oldImg, oldImg, 255, 0, cv::NORM_MINMAX);
-        cv::normalize(newImg, newImg, 255, 0, cv::NORM_MINMAX);
-        cv::Mat diff(oldImg.rows, oldImg.cols, CV_8UC1);
-        cv::absdiff(oldImg, newImg, diff);
+        cv::Mat oldNorm, newNorm;
+        cv::normalize(oldImg, oldNorm, 255, 0, cv::NORM_MINMAX);
+        cv::normalize(newImg, newNorm, 255, 0, cv::NORM_MINMAX);
+        cv::Mat diff(oldNorm.rows, oldNorm.cols, CV_8UC1);
+        cv::absdiff(oldNorm, newNorm, diff);
         cv::Scalar mean_diff = cv::mean(diff);
         return 1.0f - (float) mean_diff.val[0] / 255.0f;
     }
@@ -99,12 +76,13 @@ namespace ccalib {
             absToRelativePoint(p, imgSize);
     }
 
-    void updateCoverage(const std::vector<ccalib::Snapshot> &snapshots, ccalib::CoverageParameters &coverage) {
+    void updateCoverage(const ccalib::SnapshotStore &snapshots, ccalib::CoverageParameters &coverage) {
         // Get default values for coverage and safe current position
         ccalib::CoverageParameters newCoverage;
 
         // Loop through all snapshots
-        for (const auto &s : snapshots) {
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            const auto &s = snapshots[i];
             newCoverage.x_min = std::min(newCoverage.x_min, 1.0f - s.frame.pos.x);
             newCoverage.x_max = std::max(newCoverage.x_max, 1.0f - s.frame.pos.x);
             newCoverage.y_min = std::min(newCoverage.y_min, 1.0f - s.frame.pos.y);
@@ -134,4 +112,32 @@ namespace ccalib {
                actualFrame.skew < targetFrame.skew + tolerance && actualFrame.skew > targetFrame.skew - tolerance;
     }
 
+    /**
+     * Exports the calibration as ROS camera info YAML.
+     *
+     * @param path of the YAML file
+     * @param params calibration to export
+     * @param cameraName name written to the file
+     * @param imageSize size of the calibrated images
+     * @return true if the file could be written
+     */
+    bool writeCalibration(const std::string &path, const ccalib::CalibrationParameters &params,
+                          const std::string &cameraName, const cv::Size &imageSize) {
+        cv::FileStorage file(path, cv::FileStorage::WRITE | cv::FileStorage::FORMAT_YAML);
+        if (!file.isOpened())
+            return false;
+        file << "image_width" << imageSize.width;
+        file << "image_height" << imageSize.height;
+        file << "camera_name" << cameraName;
+        file << "camera_matrix" << params.K;
+        file << "distortion_model" << "plumb_bob";
+        file << "distortion_coefficients" << params.D;
+        file << "rectification_matrix" << cv::Mat::eye(3, 3, CV_64F);
+        cv::Mat P;
+        cv::hconcat(params.K, cv::Mat::zeros(3, 1, CV_64F), P);
+        file << "projection_matrix" << P;
+        file.release();
+        return true;
+    }
+
 } // namespace ccalib
\ No newline at end of file
@@ -5,13 +5,12 @@
 #ifndef FUNCTIONS_H
 #define FUNCTIONS_H
 
-#include <glad/glad.h>
+#include <string>
 #include <opencv2/core/mat.hpp>
+#include "snapshot_store.h"
 
 namespace ccalib {
 
-    void mat2Texture(cv::Mat &image, GLuint &imageTexture);
-
     float computeImageDiff(const cv::Mat &img1, const cv::Mat &img2, cv::Rect &rect);
 
     void flipPoints(std::vector<cv::Point2f> &points, const cv::Size &imgSize, const int &direction = 0);
@@ -26,7 +25,7 @@ namespace ccalib {
 
     void absToRelativePoints(std::vector<cv::Point2f> &points, const cv::Size &imgSize);
 
-    void updateCoverage(const std::vector<ccalib::Snapshot> &snapshots, ccalib::CoverageParameters &coverage);
+    void updateCoverage(const ccalib::SnapshotStore &snapshots, ccalib::CoverageParameters &coverage);
 
     bool checkCoverage(const ccalib::CoverageParameters &coverage, const ccalib::CheckerboardFrame &frame,
                        const float &diff = 0.05f);
@@ -34,6 +33,9 @@ namespace ccalib {
     bool checkFrameInTarget(const ccalib::CheckerboardFrame &actualFrame, const ccalib::CheckerboardFrame &targetFrame,
                             const float &tolerance = 0.05f);
 
+    bool writeCalibration(const std::string &path, const ccalib::CalibrationParameters &params,
+                          const std::string &cameraName, const cv::Size &imageSize);
+
 } // namespace ccalib
 
 #endif // FUNCTIONS_H
\ No newline at end of file
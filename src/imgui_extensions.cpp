@@ -436,4 +436,19 @@ return clicked && enabled;
         }
     }
 
+    void drawVectors(const std::vector<cv::Point2f> &origins, const std::vector<cv::Point2f> &vectors,
+                     const ImVec4 &color, const float &scale, const float &thickness) {
+        // Get Drawlist
+        ImDrawList *draw_list = ImGui::GetWindowDrawList();
+        ImU32 col_bg = ImGui::GetColorU32(color);
+
+        // Draw Vectors with a dot at their origin
+        for (int i = 0; i < origins.size() && i < vectors.size(); i++) {
+            ImVec2 from(origins[i].x, origins[i].y);
+            ImVec2 to(origins[i].x + vectors[i].x * scale, origins[i].y + vectors[i].y * scale);
+            draw_list->AddLine(from, to, col_bg, thickness);
+            draw_list->AddCircleFilled(from, thickness * 1.5f, col_bg);
+        }
+    }
+
 } // namespace ccalib
\ No newline at end of file
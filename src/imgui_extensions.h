@@ -35,6 +35,9 @@ namespace ccalib {
     void drawPoints(const std::vector<cv::Point2f> &corners, const ImVec4 &color, const float &size = 1.0f,
                     bool focus = false);
 
+    void drawVectors(const std::vector<cv::Point2f> &origins, const std::vector<cv::Point2f> &vectors,
+                     const ImVec4 &color, const float &scale = 1.0f, const float &thickness = 1.0f);
+
 } // namespace ccalib
 
 #endif // FUNCTIONS_H
\ No newline at end of file
@@ -5,11 +5,52 @@
 #ifndef IMGUI_WIDGETS_H
 #define IMGUI_WIDGETS_H
 
+#include <string>
+#include <vector>
+#include <imgui/imgui.h>
 #include "structures.h"
 #include "camera.h"
 
 namespace ccalib {
 
+    struct GUIStateVariables {
+        // Switches
+        bool showCamera = true;
+        bool showParameters = false;
+        bool showCalibration = false;
+        bool showCoverage = true;
+        bool showSnapshots = true;
+        bool showResults = true;
+        bool calibrationMode = false;
+        bool camParamsChanged = false;
+        bool frameChanged = false;
+        bool cameraOn = false;
+        bool flipImg = false;
+        bool undistort = false;
+        bool calibrated = false;
+        bool takeSnapshot = false;
+        bool inTarget = false;
+
+        // UI state variables
+        ImFont *fontTitle;
+        int widthParameterWindow = 350;
+        float widthItemSpacing = 180;
+        int frameLastAction = 0;
+        int frameCount = 0;
+        float imageMovement = 0.0f;
+        int snapID = -1;
+        float snapshotDensity = 0.06f;
+        std::string loadingSequence = "/-\\|";
+
+        // Camera specific state variables
+        int camID = 0;
+        int fpsID = 0;
+        int fmtID = 0;
+        std::vector<int> cameraFPS{5, 10, 15, 20, 30, 50, 60, 100, 120};
+        std::vector<std::string> cameraFMTS{"YUVY", "YUY2", "YU12", "YV12", "RGB3", "BGR3", "Y16 ", "MJPG", "MPEG", "X264", "HEVC"};
+        std::vector<std::string> cameras;
+    };
+
     void CameraCard (ccalib::GUIStateVariables &state, ccalib::Camera &cam, ccalib::CameraParameters &camParams);
 
     void CameraParametersCard(ccalib::GUIStateVariables &state, ccalib::Camera &cam,
@@ -8,12 +8,18 @@
 #include "imgui/imgui_internal.h"
 #include "camera.h"
 #include "calibrator.h"
+#include "calibration_scheduler.h"
+#include "detection_worker.h"
 #include "functions.h"
 #include "imgui_extensions.h"
 #include "imgui_widgets.h"
+#include "profiler.h"
+#include "texture.h"
+#include "undistorter.h"
 
 #include <SDL.h>
 #include <experimental/filesystem>
+#include <algorithm>
 #include <stack>
 
 using namespace std;
@@ -101,8 +107,10 @@ int main(int, char **) {
     bool showCoverage = true;
     bool showSnapshots = true;
     bool showResults = true;
+    bool showPerformance = false;
     bool camParamsChanged = false;
     bool frameChanged = false;
+    bool detectionChanged = false;
     bool cameraOn = false;
     bool flipImg = false;
     bool undistort = false;
@@ -110,6 +118,7 @@ int main(int, char **) {
     bool takeSnapshot = false;
     bool inTarget = false;
     bool initialized = false;
+    bool calibrationTab = false;
 
     // Camera specific state variables
     int camID = 0;
@@ -134,9 +143,21 @@ int main(int, char **) {
 
     ccalib::CoverageParameters coverage;
     ccalib::CalibrationParameters calibParams;
-    vector<ccalib::Snapshot> snapshots;
+    ccalib::SnapshotStore snapshots;
+    const vector<string> snapshotStorage = {"Gray", "JPEG", "PNG", "Board Only"};
+    int snapshotBudget = 0;     // in [MB], 0 for unlimited
     vector<cv::Point2f> corners;
+    ccalib::DetectionResult detection;
+    ccalib::DetectionResult detectionPrev;
+    ccalib::DetectionWorker detector;
+    detector.start();
     vector<double> instanceErrs;
+    vector<vector<cv::Point2f>> instanceResiduals;
+    ccalib::CalibrationScheduler calibScheduler;
+    calibScheduler.start();
+    int calibVersion = 0;
+    ccalib::Undistorter undistorter;
+    bool snapshotsChanged = false;
     float imageMovement = 0.0f;
     int snapID = -1;
     float snapshotDensity = 0.06f;
@@ -147,7 +168,9 @@ int main(int, char **) {
     vector<string> camera_fmt{"YUVY", "YUY2", "YU12", "YV12", "RGB3", "BGR3", "Y16 ", "MJPG", "MPEG", "X264", "HEVC"};
     ccalib::ImageInstance img(cv::Size(camParams.width, camParams.height), CV_8UC3);
     ccalib::ImageInstance imgPrev(cv::Size(camParams.width, camParams.height), CV_8UC3);
-    GLuint texture;
+    uint64_t frameSequence = 0; // Triple buffer sequence seen before the last capture
+    ccalib::PreviewTexture texture;
+    cv::Mat preview;
 
     // ==========================================
     // Start Initialization
@@ -170,6 +193,7 @@ int main(int, char **) {
     // Main loop
     bool done = false;
     while (!done) {
+        ccalib::ScopedTimer frameTimer("Frame");
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
 //        while (SDL_WaitEventTimeout(&event, 10)) {
@@ -263,7 +287,7 @@ int main(int, char **) {
 
                 // Camera Parameters Card
 //                ccalib::CameraParametersCard(state, cam, camParams);
-                if (ccalib::BeginCard("Camera Parameters", fontTitle, 5.5, showCamParameters)) {
+                if (ccalib::BeginCard("Camera Parameters", fontTitle, 8.5, showCamParameters)) {
                     ImGui::AlignTextToFramePadding();
                     ImGui::Text("Resolution");
                     ImGui::SameLine(spacing);
@@ -329,11 +353,38 @@ int main(int, char **) {
                         ImGui::EndCombo();
                         camParamsChanged = true;
                     }
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Native Capture");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    bool nativeCapture = camParams.backend == ccalib::CAPTURE_V4L2_MMAP;
+                    ccalib::ToggleButton("##native_toggle", &nativeCapture);
+                    if (ImGui::IsItemClicked(0)) {
+                        camParams.backend = nativeCapture ? ccalib::CAPTURE_V4L2_MMAP : ccalib::CAPTURE_OPENCV;
+                        cam.updateBackend(camParams.backend, camParams.ringSize);
+                        camParamsChanged = true;
+                    }
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Decode On Demand");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    ccalib::ToggleButton("##decode_toggle", &camParams.decodeOnDemand);
+                    if (ImGui::IsItemClicked(0))
+                        cam.updateDecodeOnDemand(camParams.decodeOnDemand);
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Buffer Ring");
+                    ImGui::SameLine(spacing);
+                    if (ImGui::InputInt("##ring_size", &camParams.ringSize, 1)) {
+                        camParams.ringSize = max(ccalib::MIN_RING_SIZE, camParams.ringSize);
+                        cam.updateBackend(camParams.backend, camParams.ringSize);
+                        camParamsChanged = true;
+                    }
                     ccalib::EndCard();
                 }
 
                 // Calibration Parameters Card
-                if (ccalib::BeginCard("Calibration Parameters", fontTitle, 4.5, showCalParameters)) {
+                if (ccalib::BeginCard("Calibration Parameters", fontTitle, 11.5 + ccalib::DETECTOR_COUNT, showCalParameters)) {
                     ImGui::AlignTextToFramePadding();
                     ImGui::Text("Rows");
                     ImGui::SameLine(spacing);
@@ -349,6 +400,124 @@ int main(int, char **) {
                     ImGui::SameLine(spacing);
                     ImGui::InputFloat("##chkbrd_size", &calib.checkerboardSize, 0.001f);
 
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Sparse Solver");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    bool sparseSolver = calib.solver == ccalib::SOLVER_SPARSE;
+                    ccalib::ToggleButton("##solver_toggle", &sparseSolver);
+                    if (ImGui::IsItemClicked(0))
+                        calib.solver = sparseSolver ? ccalib::SOLVER_SPARSE : ccalib::SOLVER_OPENCV;
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Snapshots");
+                    ImGui::SameLine(spacing);
+                    if (ImGui::BeginCombo("##snapshot_storage", snapshotStorage[snapshots.getStorage()].c_str(), 0)) {
+                        for (int i = 0; i < snapshotStorage.size(); i++) {
+                            bool is_selected = (snapshots.getStorage() == i);
+                            if (ImGui::Selectable(snapshotStorage[i].c_str(), is_selected))
+                                snapshots.setStorage((ccalib::SnapshotStorage) i);
+                            if (is_selected)
+                                ImGui::SetItemDefaultFocus();
+                        }
+                        ImGui::EndCombo();
+                    }
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Memory in [MB]");
+                    ImGui::SameLine(spacing);
+                    if (ImGui::InputInt("##snapshot_budget", &snapshotBudget, 64)) {
+                        snapshotBudget = max(0, snapshotBudget);
+                        snapshots.setMemoryBudget((size_t) snapshotBudget << 20);
+                    }
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Budget in [ms]");
+                    ImGui::SameLine(spacing);
+                    int detectionBudget = detector.getBudget();
+                    if (ImGui::InputInt("##detection_budget", &detectionBudget, 5))
+                        detector.setBudget(detectionBudget);
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Track Corners");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    bool trackCorners = detector.isTracking();
+                    ccalib::ToggleButton("##tracking_toggle", &trackCorners);
+                    if (ImGui::IsItemClicked(0))
+                        detector.setTracking(trackCorners);
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Presence Test");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    bool prefilter = detector.isPrefiltering();
+                    ccalib::ToggleButton("##prefilter_toggle", &prefilter);
+                    if (ImGui::IsItemClicked(0))
+                        detector.setPrefilter(prefilter);
+
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Detector");
+                    ImGui::SameLine(spacing);
+                    auto backend = detector.getDetector();
+                    if (ImGui::BeginCombo("##detector_backend", ccalib::detectorName(backend).c_str(), 0)) {
+                        for (int i = 0; i < ccalib::DETECTOR_COUNT; i++) {
+                            auto b = (ccalib::DetectorBackend) i;
+                            if (!ccalib::isDetectorAvailable(b))
+                                continue;
+                            bool is_selected = (backend == b);
+                            if (ImGui::Selectable(ccalib::detectorName(b).c_str(), is_selected))
+                                detector.setDetector(b);
+                            if (is_selected)
+                                ImGui::SetItemDefaultFocus();
+                        }
+                        ImGui::EndCombo();
+                    }
+
+                    // Live statistics to compare the detectors on this camera
+                    for (int i = 0; i < (int) detection.detectorStats.size(); i++) {
+                        const auto &stats = detection.detectorStats[i];
+                        ImGui::Text("%s", ccalib::detectorName((ccalib::DetectorBackend) i).c_str());
+                        ImGui::SameLine(spacing);
+                        if (stats.attempts > 0)
+                            ImGui::Text("%.1f ms, %.0f%% of %d", stats.latency,
+                                        100.0 * stats.successes / stats.attempts, stats.attempts);
+                        else
+                            ImGui::TextDisabled("no data");
+                    }
+
+                    ccalib::EndCard();
+                }
+
+                // Performance Card
+                ccalib::Profiler &profiler = ccalib::Profiler::instance();
+                int stages = profiler.stageCount();
+                float rows = profiler.isEnabled() ? stages * 0.78f : 0.0f;
+                if (ccalib::BeginCard("Performance", fontTitle, 3.5f + rows, showPerformance)) {
+                    ImGui::AlignTextToFramePadding();
+                    ImGui::Text("Profiling");
+                    ImGui::SameLine(ImGui::GetWindowWidth() - ImGui::GetFrameHeight() * 1.8f);
+                    bool profiling = profiler.isEnabled();
+                    ccalib::ToggleButton("##profiling_toggle", &profiling);
+                    if (ImGui::IsItemClicked(0))
+                        profiler.setEnabled(profiling);
+
+                    // Rolling percentiles per stage in [ms], only sorted while they are visible
+                    vector<ccalib::StageTiming> timings;
+                    if (showPerformance && profiling)
+                        timings = profiler.statistics();
+                    for (const auto &timing : timings) {
+                        ImGui::Text("%s", timing.name.c_str());
+                        ImGui::SameLine(spacing * 0.7f);
+                        ImGui::Text("%.2f / %.2f / %.2f", timing.p50, timing.p95, timing.p99);
+                    }
+
+                    // Raw events for offline analysis
+                    if (ccalib::MaterialButton("CSV", false, stages > 0))
+                        profiler.writeCSV("ccalib_profile.csv");
+                    ImGui::SameLine();
+                    if (ccalib::MaterialButton("Trace", false, stages > 0))
+                        profiler.writeTrace("ccalib_trace.json");
+                    ImGui::SameLine();
+                    if (ccalib::MaterialButton("Clear", false, stages > 0))
+                        profiler.reset();
                     ccalib::EndCard();
                 }
                 ImGui::EndTabItem();
@@ -363,9 +532,25 @@ int main(int, char **) {
             }
 
             if (cam.isStreaming()) {
-                if (cam.getFrameCount() != imgPrev.id) {
-                    img.id = cam.captureFrame(img.data);
-                    img.hasCheckerboard = false;
+                // With decode on demand, frames are only published once a capture requested them
+                uint64_t sequence = cam.getSequence();
+                if (sequence != frameSequence || camParams.decodeOnDemand) {
+                    frameSequence = sequence;
+                    // Don't convert into the buffers still held by the previous frame
+                    if (img.gray.data == imgPrev.gray.data)
+                        img.gray = cv::Mat();
+                    if (img.data.data == imgPrev.data.data)
+                        img.data = cv::Mat();
+
+                    // Calibration works on luminance only, RGB is only needed for display
+                    if (calibrationTab) {
+                        img.id = cam.captureGray(img.gray);
+                        img.data = img.gray;
+                    } else {
+                        img.id = cam.captureFrame(img.data);
+                        img.gray.release();
+                    }
+                    img.hasCheckerboard = detection.hasCheckerboard;
                     frameChanged = true;
                 } else {
                     img = imgPrev;
@@ -380,41 +565,26 @@ int main(int, char **) {
 
             if (cam.isOpened() && ImGui::BeginTabItem("Calibration")) {
 
-                // Detect Checkerboard
+                calibrationTab = true;
+
+                // Hand newest frame to the detection worker
                 if (cam.isStreaming() && frameChanged) {
-                    cv::Mat gray(img.data.rows, img.data.cols, CV_8UC1);
-                    cv::cvtColor(img.data, gray, cv::COLOR_RGB2GRAY);
-                    cv::cvtColor(gray, img.data, cv::COLOR_GRAY2RGB);
-                    cv::normalize(gray, gray, 255, 0, cv::NORM_MINMAX);
-
-                    // Use prior to clip to ROI
-                    cv::Rect prior = cv::Rect(0, 0, img.data.cols, img.data.rows);
-                    double priorScale = 1.0f;
-                    if (imgPrev.hasCheckerboard) {
-                        ccalib::Corners priorFrameCorners = frameCorners;
-                        ccalib::relativeToAbsPoints(priorFrameCorners.points,
-                                                    cv::Size(img.data.cols, img.data.rows));
-                        ccalib::increaseRectSize(priorFrameCorners.points, frame.size * img.data.cols * 0.2f);
-                        prior = prior & cv::boundingRect(priorFrameCorners.points);
-                        gray = gray(prior);
-                        cv::normalize(gray, gray, 255, 0, cv::NORM_MINMAX);
-                        priorScale = min(1.0f, gray.cols / 480.0f);
-                        float previousWidth = gray.cols;
-                        cv::resize(gray, gray, cv::Size(int(gray.cols / priorScale), int(gray.rows / priorScale)), 0, 0,
-                                   cv::INTER_LINEAR_EXACT);
-                        priorScale = previousWidth / gray.cols;
+                    if (img.gray.empty()) {
+                        ccalib::ScopedTimer timer("Gray");
+                        cv::cvtColor(img.data, img.gray, cv::COLOR_RGB2GRAY);
+                        img.data = img.gray;
                     }
+                    detector.submit(img.gray, img.id, calib, camParams);
+                }
 
-                    // Find corners
-                    if ((img.hasCheckerboard = calib.findCorners(gray, corners))) {
-                        // Add prior offset
-                        if (imgPrev.hasCheckerboard)
-                            for (auto &p : corners) {
-                                p *= priorScale;
-                                p.x += prior.x;
-                                p.y += prior.y;
-                            }
-                        calib.computeFrame(corners, camParams, frame, frameCorners);
+                // Fetch latest detection result
+                detectionChanged = snapID == -1 && detector.poll(detection);
+                if (detectionChanged) {
+                    img.hasCheckerboard = detection.hasCheckerboard;
+                    if (detection.hasCheckerboard) {
+                        corners = detection.corners;
+                        frame = detection.frame;
+                        frameCorners = detection.frameCorners;
                     } else
                         frameCorners.points.clear();
                 }
@@ -442,6 +612,10 @@ int main(int, char **) {
                         snapID = -1;
                         snapshots.clear();
                         instanceErrs.clear();
+                        instanceResiduals.clear();
+                        calibScheduler.reset();
+                        calibVersion = 0;
+                        undistorter.reset();
                     }
 
                     ccalib::EndCard();
@@ -488,30 +662,39 @@ int main(int, char **) {
                         statusText = "Capturing, don't move... ";
                     else if (img.hasCheckerboard)
                         statusText = "Ready ";
-                    else {
+                    else if (detection.diagnostics.status == ccalib::DETECTION_TIMED_OUT) {
+                        statusText = "Detection too slow! ";
+                        imageMovement = 0.0f;
+                    } else {
                         statusText = "No Checkerboard! ";
                         imageMovement = 0.0f;
                     }
 
                     // Compare actual frame with previous frame for movement
-                    if (frameChanged && img.hasCheckerboard) {
-                        cv::Rect rect = cv::minAreaRect(corners).boundingRect();
-                        imageMovement = ccalib::computeImageDiff(img.data, imgPrev.data, rect);
+                    if (detectionChanged && detection.hasCheckerboard) {
+                        if (detectionPrev.image.size() == detection.image.size()) {
+                            cv::Rect rect = cv::minAreaRect(corners).boundingRect();
+                            ccalib::ScopedTimer timer("Image Diff");
+                            imageMovement = ccalib::computeImageDiff(detection.image, detectionPrev.image, rect);
+                        }
+                        detectionPrev = detection;
                     }
 
                     // If successful, add instance
-                    if (takeSnapshot && imageMovement > 0.97f) {
+                    if (takeSnapshot && detection.hasCheckerboard && imageMovement > 0.97f) {
                         inTarget = true;
                         frameLastAction = frameCount;
 
                         // Save snapshot
                         ccalib::Snapshot instance;
-                        instance.img.data = img.data.clone();
-                        instance.img.id = img.id;
+                        instance.img.data = detection.image;
+                        instance.img.gray = detection.image;
+                        instance.img.id = detection.id;
                         instance.corners = corners;
                         instance.frame = frame;
                         instance.frameCorners = frameCorners;
-                        snapshots.push_back(instance);
+                        snapshots.add(instance);
+                        snapshotsChanged = true;
 
                         // Update coverage & calibration
                         ccalib::updateCoverage(snapshots, coverage);
@@ -519,16 +702,32 @@ int main(int, char **) {
                     }
 
                     // Update calibration parameters
-                    if (snapshots.size() >= 4 && snapshots.size() != instanceErrs.size() && !calib.isCalibrating()) {
-                        if (snapshots.size() >= 4 && !calib.isCalibrating()) {
-                            calib.calibrateCameraBG(snapshots, calibParams, instanceErrs);
-                            calibrated = calibParams.reprojErr <= 0.3f && calibParams.reprojErrVar <= 0.1f;
-                            undistort = true;
+                    if (snapshotsChanged && snapshots.size() >= 4) {
+                        calibScheduler.submit(snapshots.views(), snapshots.imageSize(), calib);
+                        snapshotsChanged = false;
+                    }
+                    auto calibResult = calibScheduler.latest();
+                    if (calibResult && calibResult->version != calibVersion) {
+                        calibVersion = calibResult->version;
+                        calibParams = calibResult->params;
+                        calibrated = calibResult->calibrated;
+                        undistort = true;
+
+                        // Match errors by id, snapshots taken during the solve come last
+                        instanceErrs.clear();
+                        instanceResiduals.clear();
+                        for (size_t i = 0; i < snapshots.size(); i++) {
+                            auto it = find(calibParams.viewIds.begin(), calibParams.viewIds.end(), snapshots.id(i));
+                            if (it == calibParams.viewIds.end())
+                                break;
+                            instanceErrs.push_back(calibResult->errs[it - calibParams.viewIds.begin()]);
+                            instanceResiduals.push_back(calibResult->residuals[it - calibParams.viewIds.begin()]);
                         }
-                    } else if (calib.isCalibrating())
+                    }
+                    if (calibScheduler.isBusy())
                         statusText = "Calibrating... ";
 
-                    if (takeSnapshot || calib.isCalibrating() || !initialized)
+                    if (takeSnapshot || calibScheduler.isBusy() || !initialized)
                         statusText += loadingSequence[frameCount % 8 / 2];
 
                     ImGui::SameLine();
@@ -570,12 +769,20 @@ int main(int, char **) {
                             ImGui::SameLine();
                             if (ccalib::HoverableDeleteButton(text, ImVec2(24, size.y + 4), deleteAdvice)) {
                                 // Update Snapshots & Coverage
-                                snapshots.erase(snapshots.begin() + i);
+                                snapshots.erase(i);
+                                if (instanceErrs.size() > i) {
+                                    instanceErrs.erase(instanceErrs.begin() + i);
+                                    instanceResiduals.erase(instanceResiduals.begin() + i);
+                                }
                                 snapID = -1;
+                                snapshotsChanged = true;
                                 ccalib::updateCoverage(snapshots, coverage);
                                 if (snapshots.size() < 4) {
                                     instanceErrs.clear();
+                                    instanceResiduals.clear();
                                     calibrated = false;
+                                    calibScheduler.reset();
+                                    calibVersion = 0;
                                 }
                                 if (snapshots.empty())
                                     initialized = false;
@@ -591,6 +798,7 @@ int main(int, char **) {
                 }
                 ImGui::EndTabItem();
             } else {
+                calibrationTab = false;
                 corners.clear();
                 frameCorners.points.clear();
             }
@@ -604,18 +812,8 @@ int main(int, char **) {
                 if (ccalib::BeginCard("Results", fontTitle, 7.5, showResults)) {
                     if (ccalib::MaterialButton("Export", calibrated)) {
                         frameLastAction = frameCount;
-                        cv::FileStorage file("calibration.yaml", cv::FileStorage::WRITE | cv::FileStorage::FORMAT_YAML);
-                        file << "image_width" << camParams.width;
-                        file << "image_height" << camParams.height;
-                        file << "camera_name" << cameras[camID];
-                        file << "camera_matrix" << calibParams.K;
-                        file << "distortion_model" << "plumb_bob";
-                        file << "distortion_coefficients" << calibParams.D;
-                        file << "rectification_matrix" << cv::Mat::eye(3, 3, CV_64F);
-                        cv::Mat P;
-                        cv::hconcat(calibParams.K, cv::Mat::zeros(3, 1, CV_64F), P);
-                        file << "projection_matrix" << P;
-                        file.release();
+                        ccalib::writeCalibration("calibration.yaml", calibParams, cameras[camID],
+                                                 cv::Size(camParams.width, camParams.height));
                     }
                     if (frameCount - frameLastAction < 60) {
                         ImGui::SameLine();
@@ -638,9 +836,10 @@ int main(int, char **) {
 
             if (snapID != -1) {
                 cam.stopStream();
+                // Shares the restored snapshot image, which must stay untouched
                 img = snapshots[snapID].img;
+                img.data = img.gray = snapshots.image(snapID);
                 img.hasCheckerboard = true;
-                img.data = snapshots[snapID].img.data.clone();
                 corners = snapshots[snapID].corners;
                 frame = snapshots[snapID].frame;
                 frameCorners = snapshots[snapID].frameCorners;
@@ -648,10 +847,12 @@ int main(int, char **) {
                 takeSnapshot = false;
             } else if (cam.isOpened() && !cam.isStreaming()) {
                 cam.startStream();
+                img.data.release();
+                img.gray.release();
                 img.id = cam.captureFrame(img.data);
             } else {
+                // Share the buffers, the next capture won't write into them
                 imgPrev = img;
-                imgPrev.data = img.data.clone();
             }
         }
 
@@ -672,42 +873,41 @@ int main(int, char **) {
                      ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse |
                      ImGuiWindowFlags_NoTitleBar);
 
-        // Image to texture
-        cv::Mat preview = img.data.clone();
-        if (cameraOn) {
-            if (snapID == -1) {
-                if (undistort)
-                    cv::undistort(img.data, preview, calibParams.K, calibParams.D);
-                if (flipImg)
-                    cv::flip(preview, preview, 1);
-            }
-            if (frameChanged) {
-                glDeleteTextures(1, &texture);
-                ccalib::mat2Texture(preview, texture);
+        // Image to texture, uploaded at native resolution and scaled by the textured quad
+        if (cameraOn && frameChanged) {
+            const cv::Mat *source = &img.data;
+            if (snapID == -1 && (undistort || flipImg)) {
+                ccalib::ScopedTimer timer("Preview Transform");
+                if (undistort) {
+                    // Single remap, maps are only rebuilt when calibration, frame size or flip change
+                    undistorter.update(calibParams.K, calibParams.D, img.data.size(), flipImg);
+                    undistorter.undistort(img.data, preview);
+                } else
+                    cv::flip(img.data, preview, 1);
+                source = &preview;
             }
+            texture.upload(*source);
         }
 
-        // Resize Camera image
+        // Fit the camera image into the available area
         float widthAvail = ImGui::GetContentRegionAvail().x;
         float heightAvail = ImGui::GetContentRegionAvail().y;
         float scaling = 1.0f;
-        cv::Size imgSizeOld(preview.cols, preview.rows);
-        if (!preview.empty()) {
-            if (heightAvail * camParams.ratio > widthAvail) {
-                scaling = widthAvail / preview.cols;
-                cv::resize(preview, preview, cv::Size((int) widthAvail, (int) (widthAvail / camParams.ratio)));
-            } else {
-                scaling = heightAvail / preview.rows;
-                cv::resize(preview, preview,
-                           cv::Size((int) (heightAvail * camParams.ratio), (int) heightAvail));
-            }
+        cv::Size imgSizeOld(img.data.cols, img.data.rows);
+        ImVec2 previewSize(0.0f, 0.0f);
+        if (!img.data.empty()) {
+            if (heightAvail * camParams.ratio > widthAvail)
+                previewSize = ImVec2(widthAvail, widthAvail / camParams.ratio);
+            else
+                previewSize = ImVec2(heightAvail * camParams.ratio, heightAvail);
+            scaling = previewSize.x / img.data.cols;
         }
 
         // Positioning && Centering
-        ImVec2 pos = ImVec2((widthAvail - preview.cols) / 2 + ImGui::GetCursorPosX(),
-                            (heightAvail - preview.rows) / 2 + ImGui::GetCursorPosY());
+        ImVec2 pos = ImVec2((widthAvail - previewSize.x) / 2 + ImGui::GetCursorPosX(),
+                            (heightAvail - previewSize.y) / 2 + ImGui::GetCursorPosY());
         ImGui::SetCursorPos(pos);
-        ImGui::Image((void *) (intptr_t) texture, ImVec2(preview.cols, preview.rows));
+        ImGui::Image((void *) (intptr_t) texture.id(), previewSize);
         cv::Point2f offset(pos.x + widthParameterWindow, pos.y);
 
         // Draw Corners & Frame
@@ -745,6 +945,11 @@ int main(int, char **) {
 
             // Draw
             ccalib::drawPoints(temp_c, ImVec4(0.56f, 0.83f, 0.26f, 1.00f), frame.size * 4.0f);
+
+            // Draw magnified reprojection errors of the selected snapshot
+            if (snapID != -1 && snapID < instanceResiduals.size())
+                ccalib::drawVectors(temp_c, instanceResiduals[snapID], ImVec4(0.91f, 0.26f, 0.26f, 1.00f),
+                                    scaling * 20.0f, 2.0f);
             if (inTarget) {
                 ccalib::drawRectangle(temp_fc.points, ImVec4(0.13f, 0.83f, 0.91f, 1.00f), 16.0f, false);
                 if (frameCount - frameLastAction > 10)
@@ -779,14 +984,14 @@ int main(int, char **) {
         // Display reprojection error
         if (snapshots.size() >= 4 && calibParams.reprojErr != DBL_MAX) {
             string reproj_error;
-            if (snapID == -1)
+            if (snapID == -1 || snapID >= instanceErrs.size())
                 reproj_error = "Mean Reprojection Error: " + to_string(calibParams.reprojErr);
             else
                 reproj_error = "Reprojection Error: " + to_string(instanceErrs[snapID]);
             float text_width = ImGui::CalcTextSize(reproj_error.c_str()).x;
-            ImGui::SetCursorPos(ImVec2(pos.x + preview.cols - text_width - 16, pos.y + 17));
+            ImGui::SetCursorPos(ImVec2(pos.x + previewSize.x - text_width - 16, pos.y + 17));
             ImGui::TextColored(ImColor(0, 0, 0, 255), "%s", reproj_error.c_str());
-            ImGui::SetCursorPos(ImVec2(pos.x + preview.cols - text_width - 16, pos.y + 16));
+            ImGui::SetCursorPos(ImVec2(pos.x + previewSize.x - text_width - 16, pos.y + 16));
             ImGui::TextColored(ImColor(255, 255, 255, 255), "%s", reproj_error.c_str());
         }
 
@@ -794,15 +999,19 @@ int main(int, char **) {
         ImGui::PopStyleColor(1);
 
         // Rendering
-        ImGui::Render();
-        glViewport(0, 0, (int) io.DisplaySize.x, (int) io.DisplaySize.y);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        {
+            ccalib::ScopedTimer timer("Render");
+            ImGui::Render();
+            glViewport(0, 0, (int) io.DisplaySize.x, (int) io.DisplaySize.y);
+            glClear(GL_COLOR_BUFFER_BIT);
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
         SDL_GL_SwapWindow(window);
         frameCount++;
     }
 
     // Cleanup ImGui
+    texture.release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
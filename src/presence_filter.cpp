@@ -0,0 +1,88 @@
+#include "presence_filter.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Checkerboard Presence Test
+ * =====================================================================
+ * Inner corners of a checkerboard are saddle points of the intensity,
+ * where the Hessian determinant is strongly negative. The response
+ * Ixy^2 - Ixx * Iyy is computed on a heavily downscaled frame and its
+ * local maxima are counted. Frames without enough saddle points are
+ * rejected, otherwise the bounding box of the maxima serves as a coarse
+ * ROI. Only vectorized OpenCV primitives are used on the full image
+ * (area resize) and the small image (filters, arithmetic, dilation).
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    PresenceFilter::PresenceFilter() {}
+
+    PresenceFilter::~PresenceFilter() {}
+
+    /**
+     * Tests whether the frame may contain the checkerboard.
+     *
+     * @param gray 8-bit gray image
+     * @param patternSize inner corners per row and column
+     * @param roi coarse region of the checkerboard, if present
+     * @return false if the checkerboard is certainly not in the frame
+     */
+    bool PresenceFilter::check(const cv::Mat &gray, const cv::Size &patternSize, cv::Rect &roi) {
+        roi = cv::Rect(0, 0, gray.cols, gray.rows);
+        if (gray.cols <= width)
+            gray.convertTo(small, CV_32F, 1.0 / 255);
+        else {
+            cv::resize(gray, small, cv::Size(width, gray.rows * width / gray.cols), 0, 0, cv::INTER_AREA);
+            small.convertTo(small, CV_32F, 1.0 / 255);
+        }
+
+        // Contrast normalization keeps the threshold independent of the exposure
+        cv::normalize(small, small, 1.0, 0.0, cv::NORM_MINMAX);
+        cv::GaussianBlur(small, small, cv::Size(5, 5), 1.0);
+
+        // Negative Hessian determinant, scaled to unit kernel gain
+        cv::Sobel(small, Ixx, CV_32F, 2, 0, 3, 0.25);
+        cv::Sobel(small, Iyy, CV_32F, 0, 2, 3, 0.25);
+        cv::Sobel(small, Ixy, CV_32F, 1, 1, 3, 0.25);
+        cv::multiply(Ixy, Ixy, response);
+        cv::multiply(Ixx, Iyy, Ixx);
+        cv::subtract(response, Ixx, response);
+
+        double maxResponse;
+        cv::minMaxLoc(response, nullptr, &maxResponse);
+        if (maxResponse < minResponse)
+            return false;
+
+        // Count local maxima of the saddle response
+        cv::dilate(response, maxima, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 5)));
+        cv::compare(response, maxima, mask, cv::CMP_GE);
+        cv::Mat strong = response > max((double) minResponse, maxResponse * relativeResponse);
+        cv::bitwise_and(mask, strong, mask);
+        auto count = cv::countNonZero(mask);
+        if (count < minFraction * patternSize.area())
+            return false;
+
+        // Bounding box of the saddle points. Corners at the board edge may fall below the threshold, so pad
+        // by the part of the full board extent (inner corners plus outer squares) which the box doesn't cover,
+        // but by at least two squares. The area per saddle point serves as square size.
+        std::vector<cv::Point> points;
+        cv::findNonZero(mask, points);
+        cv::Rect box = cv::boundingRect(points);
+        double square = sqrt((double) box.area() / count);
+        double extent = (max(patternSize.width, patternSize.height) + 1) * square;
+        auto pad = (int) max(4.0, max(2.0 * square, extent - max(box.width, box.height)));
+        box = cv::Rect(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad);
+
+        double scale = (double) gray.cols / small.cols;
+        roi = cv::Rect(cv::Point((int) (box.x * scale), (int) (box.y * scale)),
+                       cv::Point((int) ceil(box.br().x * scale), (int) ceil(box.br().y * scale)));
+        roi &= cv::Rect(0, 0, gray.cols, gray.rows);
+        return roi.area() > 0;
+    }
+
+} // namespace ccalib
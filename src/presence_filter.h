@@ -0,0 +1,29 @@
+#ifndef PRESENCE_FILTER_H
+#define PRESENCE_FILTER_H
+
+#include <opencv2/opencv.hpp>
+
+namespace ccalib {
+
+    class PresenceFilter {
+    private:
+        cv::Mat small, response, maxima, mask;
+        cv::Mat Ixx, Iyy, Ixy;
+
+    public:
+
+        int width = 320;              // in [px], width of the downscaled test image
+        float minResponse = 1e-3f;    // saddle response of a low contrast corner
+        float relativeResponse = 0.2f; // relative to the strongest saddle point
+        float minFraction = 0.5f;     // of the inner corners needed to pass
+
+        PresenceFilter();
+
+        ~PresenceFilter();
+
+        bool check(const cv::Mat &gray, const cv::Size &patternSize, cv::Rect &roi);
+    };
+
+} // namespace ccalib
+
+#endif // PRESENCE_FILTER_H
@@ -0,0 +1,177 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Pipeline Stage Profiling
+ * =====================================================================
+ * ScopedTimer measures a named stage from construction to destruction
+ * and reports it to the process wide Profiler. While profiling is
+ * disabled a timer costs one atomic load. Every stage keeps a rolling
+ * window of durations for the percentiles, all events are kept in a
+ * bounded log for export as CSV or as Chrome trace JSON, which can be
+ * opened in chrome://tracing or Perfetto.
+ * Stage names must be string literals, events only keep the pointer.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    // Small stable ids instead of the opaque std::thread::id
+    static int threadIndex() {
+        static std::atomic<int> threads{0};
+        thread_local int index = threads++;
+        return index;
+    }
+
+    Profiler::Profiler() : origin(std::chrono::steady_clock::now()) {}
+
+    Profiler &Profiler::instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void Profiler::setEnabled(const bool &enable) {
+        enabled = enable;
+    }
+
+    bool Profiler::isEnabled() {
+        return enabled;
+    }
+
+    int Profiler::stageCount() {
+        return registeredStages;
+    }
+
+    /**
+     * Looks up a stage by the address of its name. Equal names at different
+     * addresses, e.g. from different translation units, share one stage.
+     * Must be called with the mutex held.
+     */
+    Profiler::Stage &Profiler::findStage(const char *name) {
+        auto it = stageIndex.find(name);
+        if (it != stageIndex.end())
+            return stages[it->second];
+
+        size_t index = 0;
+        while (index < stages.size() && std::strcmp(stages[index].name, name) != 0)
+            index++;
+        if (index == stages.size()) {
+            stages.push_back(Stage{name, std::deque<double>()});
+            registeredStages = (int) stages.size();
+        }
+        stageIndex[name] = index;
+        return stages[index];
+    }
+
+    void Profiler::record(const char *stage, const std::chrono::steady_clock::time_point &start,
+                          const std::chrono::steady_clock::time_point &end) {
+        TraceEvent event;
+        event.stage = stage;
+        event.thread = threadIndex();
+        event.start = std::chrono::duration<double, std::micro>(start - origin).count();
+        event.duration = std::chrono::duration<double, std::micro>(end - start).count();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::deque<double> &stageSamples = findStage(stage).samples;
+        stageSamples.push_back(event.duration / 1000.0);
+        if (stageSamples.size() > window)
+            stageSamples.pop_front();
+        events.push_back(event);
+        if (events.size() > maxEvents)
+            events.pop_front();
+    }
+
+    /**
+     * Percentiles of every stage over its rolling window.
+     *
+     * @return timings sorted by stage name
+     */
+    std::vector<StageTiming> Profiler::statistics() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<StageTiming> timings;
+        for (const auto &stage : stages) {
+            if (stage.samples.empty())
+                continue;
+            std::vector<double> sorted(stage.samples.begin(), stage.samples.end());
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&sorted](const double &p) {
+                return sorted[min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+            };
+            StageTiming timing;
+            timing.name = stage.name;
+            timing.count = (int) sorted.size();
+            timing.p50 = percentile(0.50);
+            timing.p95 = percentile(0.95);
+            timing.p99 = percentile(0.99);
+            timing.last = stage.samples.back();
+            timings.push_back(timing);
+        }
+        std::sort(timings.begin(), timings.end(), [](const StageTiming &a, const StageTiming &b) {
+            return a.name < b.name;
+        });
+        return timings;
+    }
+
+    /**
+     * Writes one line per recorded event: stage, thread, start and duration in [us].
+     */
+    bool Profiler::writeCSV(const std::string &path) {
+        std::ofstream file(path);
+        if (!file.is_open())
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        file << "stage,thread,start_us,duration_us" << endl;
+        file << fixed << setprecision(1);
+        for (const auto &event : events)
+            file << event.stage << "," << event.thread << "," << event.start << "," << event.duration << "\n";
+        return file.good();
+    }
+
+    /**
+     * Writes all recorded events as complete events of the Chrome trace format.
+     */
+    bool Profiler::writeTrace(const std::string &path) {
+        std::ofstream file(path);
+        if (!file.is_open())
+            return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        file << "{\"traceEvents\":[" << endl;
+        file << fixed << setprecision(1);
+        for (size_t i = 0; i < events.size(); i++) {
+            const auto &event = events[i];
+            file << "{\"name\":\"" << event.stage << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread
+                 << ",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}"
+                 << (i + 1 < events.size() ? ",\n" : "\n");
+        }
+        file << "],\"displayTimeUnit\":\"ms\"}" << endl;
+        return file.good();
+    }
+
+    void Profiler::reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        stageIndex.clear();
+        stages.clear();
+        registeredStages = 0;
+        events.clear();
+    }
+
+    ScopedTimer::ScopedTimer(const char *stageName) : stage(stageName), active(Profiler::instance().isEnabled()) {
+        if (active)
+            start = std::chrono::steady_clock::now();
+    }
+
+    ScopedTimer::~ScopedTimer() {
+        if (active)
+            Profiler::instance().record(stage, start, std::chrono::steady_clock::now());
+    }
+
+} // namespace ccalib
@@ -0,0 +1,94 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ccalib {
+
+    struct StageTiming {
+        std::string name;
+        int count = 0;          // samples in the rolling window
+        double p50 = 0.0;       // in [ms]
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double last = 0.0;
+    };
+
+    struct TraceEvent {
+        const char *stage;
+        int thread;
+        double start;           // in [us] since the profiler was started
+        double duration;        // in [us]
+    };
+
+    class Profiler {
+    private:
+        std::atomic<bool> enabled{false};
+        std::chrono::steady_clock::time_point origin;
+
+        struct Stage {
+            const char *name;
+            std::deque<double> samples;
+        };
+
+        std::mutex mutex;
+        std::map<const char *, size_t> stageIndex;  // keyed by the address of the name literal
+        std::vector<Stage> stages;
+        std::atomic<int> registeredStages{0};
+        std::deque<TraceEvent> events;
+
+        Stage &findStage(const char *name);
+
+        Profiler();
+
+    public:
+
+        size_t window = 256;        // samples per stage for the percentiles
+        size_t maxEvents = 100000;  // events kept for the export
+
+        static Profiler &instance();
+
+        void setEnabled(const bool &enable);
+
+        bool isEnabled();
+
+        int stageCount();
+
+        void record(const char *stage, const std::chrono::steady_clock::time_point &start,
+                    const std::chrono::steady_clock::time_point &end);
+
+        std::vector<StageTiming> statistics();
+
+        bool writeCSV(const std::string &path);
+
+        bool writeTrace(const std::string &path);
+
+        void reset();
+    };
+
+    class ScopedTimer {
+    private:
+        const char *stage;
+        bool active;
+        std::chrono::steady_clock::time_point start;
+
+    public:
+
+        explicit ScopedTimer(const char *stageName);
+
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer &) = delete;
+
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+    };
+
+} // namespace ccalib
+
+#endif // PROFILER_H
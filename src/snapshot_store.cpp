@@ -0,0 +1,262 @@
+#include "snapshot_store.h"
+
+#include <cstdio>
+#include <fstream>
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Snapshot Store
+ * =====================================================================
+ * Snapshots are immutable once added. Calibration only gets the corners
+ * and the image size, the image is kept for review and redetection.
+ * How it is kept is set by the storage policy for new snapshots:
+ * gray (shared, no copy if already gray), JPEG or PNG in memory, or a
+ * gray crop around the board. Past the memory budget the oldest images
+ * are spilled to temporary files. image() restores a full size frame,
+ * the last one is cached.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    size_t StoredImage::bytes() const {
+        return data.total() * data.elemSize() + encoded.size();
+    }
+
+    SnapshotStore::SnapshotStore() {}
+
+    SnapshotStore::~SnapshotStore() {
+        clear();
+    }
+
+    /**
+     * Sets how new snapshots are kept. Images already stored keep their form,
+     * the budget is applied again right away.
+     */
+    void SnapshotStore::setStorage(const SnapshotStorage &policy) {
+        storage = policy;
+        enforceBudget();
+    }
+
+    SnapshotStorage SnapshotStore::getStorage() const {
+        return storage;
+    }
+
+    /**
+     * Sets the memory budget and spills images beyond it right away.
+     *
+     * @param bytes budget in [byte], 0 for unlimited
+     */
+    void SnapshotStore::setMemoryBudget(const size_t &bytes) {
+        memoryBudget = bytes;
+        enforceBudget();
+    }
+
+    size_t SnapshotStore::getMemoryBudget() const {
+        return memoryBudget;
+    }
+
+    /**
+     * Adds a snapshot. Depending on the storage policy the image is shared,
+     * so it must not be modified afterwards.
+     *
+     * @param snapshot to add
+     * @return id of the snapshot, unique for the lifetime of the store
+     */
+    int SnapshotStore::add(const Snapshot &snapshot) {
+        if (snapshots.empty())
+            frameSize = snapshot.img.data.size();
+
+        Entry entry;
+        entry.id = nextId++;
+        entry.image = store(snapshot);
+        auto meta = std::make_shared<Snapshot>(snapshot);
+        meta->img.data.release();
+        meta->img.gray.release();
+        entry.snapshot = meta;
+        snapshots.push_back(entry);
+        enforceBudget();
+        return entry.id;
+    }
+
+    std::shared_ptr<StoredImage> SnapshotStore::store(const Snapshot &snapshot) {
+        auto image = std::make_shared<StoredImage>();
+        image->size = snapshot.img.data.size();
+        image->roi = cv::Rect(cv::Point(0, 0), image->size);
+
+        cv::Mat gray = snapshot.img.gray.empty() ? snapshot.img.data : snapshot.img.gray;
+        if (gray.channels() == 3)
+            cv::cvtColor(gray, gray, cv::COLOR_RGB2GRAY);
+
+        switch (storage) {
+            case STORAGE_JPEG:
+                cv::imencode(".jpg", gray, image->encoded, {cv::IMWRITE_JPEG_QUALITY, jpegQuality});
+                break;
+            case STORAGE_PNG:
+                cv::imencode(".png", gray, image->encoded, {cv::IMWRITE_PNG_COMPRESSION, 1});
+                break;
+            case STORAGE_ROI:
+                if (!snapshot.corners.empty()) {
+                    // Pad by about two squares to keep the outer corners refinable
+                    cv::Rect box = cv::boundingRect(snapshot.corners);
+                    auto pad = (int) (2.0 * sqrt((double) box.area() / snapshot.corners.size()));
+                    box = cv::Rect(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad);
+                    image->roi = box & image->roi;
+                }
+                image->data = gray(image->roi).clone();
+                break;
+            default:
+                image->data = gray;
+        }
+        return image;
+    }
+
+    /**
+     * Spills the oldest images held in memory until the budget is met.
+     */
+    void SnapshotStore::enforceBudget() {
+        if (memoryBudget == 0)
+            return;
+        size_t usage = memoryUsage();
+        for (auto &entry : snapshots) {
+            if (usage <= memoryBudget)
+                break;
+            if (!entry.image->path.empty())
+                continue;
+            size_t bytes = entry.image->bytes();
+            spill(*entry.image);
+            if (!entry.image->path.empty())
+                usage -= bytes;
+        }
+    }
+
+    void SnapshotStore::spill(StoredImage &image) {
+        std::string path = cv::tempfile(image.encoded.empty() ? ".png" : "");
+        bool written;
+        if (image.encoded.empty())
+            written = cv::imwrite(path, image.data);
+        else {
+            std::ofstream file(path, std::ios::binary);
+            file.write((const char *) image.encoded.data(), image.encoded.size());
+            written = file.good();
+        }
+        if (!written) {
+            // Keep it in memory rather than losing it
+            std::remove(path.c_str());
+            return;
+        }
+        image.path = path;
+        image.data.release();
+        std::vector<uchar>().swap(image.encoded);
+    }
+
+    void SnapshotStore::discard(StoredImage &image) {
+        if (!image.path.empty())
+            std::remove(image.path.c_str());
+        image.path.clear();
+    }
+
+    void SnapshotStore::erase(const size_t &index) {
+        if (index >= snapshots.size())
+            return;
+        discard(*snapshots[index].image);
+        snapshots.erase(snapshots.begin() + index);
+    }
+
+    void SnapshotStore::clear() {
+        for (auto &entry : snapshots)
+            discard(*entry.image);
+        snapshots.clear();
+        cachedImage.reset();
+        cachedData.release();
+        frameSize = cv::Size();
+    }
+
+    size_t SnapshotStore::size() const {
+        return snapshots.size();
+    }
+
+    bool SnapshotStore::empty() const {
+        return snapshots.empty();
+    }
+
+    /**
+     * @return snapshot without its image, see image()
+     */
+    const Snapshot &SnapshotStore::operator[](const size_t &index) const {
+        return *snapshots[index].snapshot;
+    }
+
+    std::shared_ptr<const Snapshot> SnapshotStore::at(const size_t &index) const {
+        return snapshots.at(index).snapshot;
+    }
+
+    /**
+     * Identifies a snapshot across erase() and calibrations. Camera frame ids
+     * restart whenever the device is reopened and can't be used for this.
+     */
+    int SnapshotStore::id(const size_t &index) const {
+        return snapshots.at(index).id;
+    }
+
+    /**
+     * Restores the image of a snapshot at full frame size. Regions outside
+     * a cropped ROI are black.
+     *
+     * @param index of the snapshot
+     * @return 8-bit gray image, must not be modified
+     */
+    cv::Mat SnapshotStore::image(const size_t &index) const {
+        const auto &stored = snapshots.at(index).image;
+        if (stored == cachedImage)
+            return cachedData;
+
+        cv::Mat pixels;
+        if (!stored->path.empty())
+            pixels = cv::imread(stored->path, cv::IMREAD_GRAYSCALE);
+        else if (!stored->encoded.empty())
+            pixels = cv::imdecode(stored->encoded, cv::IMREAD_GRAYSCALE);
+        else
+            pixels = stored->data;
+
+        if (!pixels.empty() && stored->roi.size() != stored->size) {
+            cv::Mat frame = cv::Mat::zeros(stored->size, pixels.type());
+            pixels.copyTo(frame(stored->roi));
+            pixels = frame;
+        }
+        cachedImage = stored;
+        cachedData = pixels;
+        return pixels;
+    }
+
+    /**
+     * @return corners and id of every snapshot, in order
+     */
+    std::vector<CalibrationView> SnapshotStore::views() const {
+        std::vector<CalibrationView> views(snapshots.size());
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            views[i].id = snapshots[i].id;
+            views[i].corners = snapshots[i].snapshot->corners;
+        }
+        return views;
+    }
+
+    cv::Size SnapshotStore::imageSize() const {
+        return frameSize;
+    }
+
+    /**
+     * @return bytes held in memory by the snapshot images
+     */
+    size_t SnapshotStore::memoryUsage() const {
+        size_t usage = 0;
+        for (const auto &entry : snapshots)
+            usage += entry.image->bytes();
+        return usage;
+    }
+
+} // namespace ccalib
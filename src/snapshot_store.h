@@ -0,0 +1,98 @@
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "structures.h"
+
+namespace ccalib {
+
+    enum SnapshotStorage {
+        STORAGE_GRAY = 0,   // 8-bit gray, shared if already gray
+        STORAGE_JPEG = 1,   // compressed in memory, lossy
+        STORAGE_PNG = 2,    // compressed in memory, lossless
+        STORAGE_ROI = 3     // 8-bit gray crop around the checkerboard
+    };
+
+    struct StoredImage {
+        cv::Mat data;                   // gray or cropped pixels, empty if encoded or spilled
+        std::vector<uchar> encoded;     // compressed pixels, empty if raw or spilled
+        std::string path;               // file holding the pixels once spilled
+        cv::Rect roi;                   // region of the frame held
+        cv::Size size;                  // size of the frame
+
+        size_t bytes() const;
+    };
+
+    class SnapshotStore {
+    private:
+        struct Entry {
+            int id;
+            std::shared_ptr<const Snapshot> snapshot;
+            std::shared_ptr<StoredImage> image;
+        };
+
+        std::vector<Entry> snapshots;
+        cv::Size frameSize;
+        int nextId = 0;             // never reused, unlike camera frame ids
+        SnapshotStorage storage = STORAGE_GRAY;
+        size_t memoryBudget = 0;    // in [byte], images beyond are spilled to disk, 0 for unlimited
+
+        // Last decoded image, selecting a snapshot decodes only once
+        mutable std::shared_ptr<const StoredImage> cachedImage;
+        mutable cv::Mat cachedData;
+
+        std::shared_ptr<StoredImage> store(const Snapshot &snapshot);
+
+        void enforceBudget();
+
+        void spill(StoredImage &image);
+
+        static void discard(StoredImage &image);
+
+    public:
+
+        int jpegQuality = 90;
+
+        SnapshotStore();
+
+        ~SnapshotStore();
+
+        void setStorage(const SnapshotStorage &policy);
+
+        SnapshotStorage getStorage() const;
+
+        void setMemoryBudget(const size_t &bytes);
+
+        size_t getMemoryBudget() const;
+
+        int add(const Snapshot &snapshot);
+
+        void erase(const size_t &index);
+
+        void clear();
+
+        size_t size() const;
+
+        bool empty() const;
+
+        const Snapshot &operator[](const size_t &index) const;
+
+        std::shared_ptr<const Snapshot> at(const size_t &index) const;
+
+        int id(const size_t &index) const;
+
+        cv::Mat image(const size_t &index) const;
+
+        std::vector<CalibrationView> views() const;
+
+        cv::Size imageSize() const;
+
+        size_t memoryUsage() const;
+    };
+
+} // namespace ccalib
+
+#endif // SNAPSHOT_STORE_H
@@ -5,8 +5,10 @@
 #ifndef STRUCTURES_H
 #define STRUCTURES_H
 
+#include <cfloat>
+#include <string>
+#include <vector>
 #include <opencv2/core/mat.hpp>
-#include <imgui/imgui.h>
 
 namespace ccalib {
 
@@ -28,12 +30,56 @@ namespace ccalib {
 
     struct ImageInstance {
         cv::Mat data;
+        cv::Mat gray;
         int id = 0;
         bool hasCheckerboard = false;
         ImageInstance() = default;
         ImageInstance(const cv::Size &size, const int &type) { data = cv::Mat::zeros(size, type); }
     };
 
+    enum DetectionStatus {
+        DETECTION_FOUND = 0,
+        DETECTION_NOT_FOUND = 1,
+        DETECTION_TIMED_OUT = 2,
+        DETECTION_CANCELLED = 3
+    };
+
+    struct DetectionDiagnostics {
+        DetectionStatus status = DETECTION_NOT_FOUND;
+        double budget = 0.0;    // in [ms]
+        double elapsed = 0.0;   // in [ms]
+        double scale = 1.0;     // downscaling factor of the search image
+        int cornersFound = 0;   // corners found before refinement
+        bool refined = false;
+        bool tracked = false;   // propagated by optical flow instead of detected
+        bool rejected = false;  // skipped by the presence test
+    };
+
+    enum DetectorBackend {
+        DETECTOR_CLASSIC = 0,
+        DETECTOR_SECTOR = 1,
+        DETECTOR_COUNT
+    };
+
+    struct DetectorStats {
+        int attempts = 0;
+        int successes = 0;
+        double latency = 0.0;   // in [ms], mean per detection
+        double cost = 0.0;      // in [ms] per megapixel, moving average per pyramid search
+    };
+
+    struct DetectionResult {
+        cv::Mat image;
+        int id = -1;
+        bool hasCheckerboard = false;
+        std::vector<cv::Point2f> corners;
+        CheckerboardFrame frame;
+        Corners frameCorners;
+        DetectionDiagnostics diagnostics;
+        DetectorBackend backend = DETECTOR_CLASSIC;
+        std::vector<DetectorStats> detectorStats;
+    };
+
     struct Snapshot {
         ImageInstance img;
         Corners frameCorners;
@@ -41,6 +87,19 @@ namespace ccalib {
         std::vector<cv::Point2f> corners;
     };
 
+    struct CalibrationView {
+        int id = 0;     // snapshot id, see SnapshotStore::id
+        std::vector<cv::Point2f> corners;
+    };
+
+    enum CaptureBackend {
+        CAPTURE_OPENCV = 0,
+        CAPTURE_V4L2_MMAP = 1
+    };
+
+    // Three buffers can be held by the frame handoff, the driver needs at least one more
+    const int MIN_RING_SIZE = 4;
+
     struct CameraParameters {
         bool autoExposure;
         int width;
@@ -49,6 +108,9 @@ namespace ccalib {
         float exposure;
         float ratio;
         std::string format;
+        CaptureBackend backend = CAPTURE_OPENCV;
+        int ringSize = MIN_RING_SIZE;
+        bool decodeOnDemand = false;
     };
 
     struct CoverageParameters {
@@ -62,42 +124,9 @@ namespace ccalib {
         float skew_max = 0.0f;
     };
 
-    struct GUIStateVariables {
-        // Switches
-        bool showCamera = true;
-        bool showParameters = false;
-        bool showCalibration = false;
-        bool showCoverage = true;
-        bool showSnapshots = true;
-        bool showResults = true;
-        bool calibrationMode = false;
-        bool camParamsChanged = false;
-        bool frameChanged = false;
-        bool cameraOn = false;
-        bool flipImg = false;
-        bool undistort = false;
-        bool calibrated = false;
-        bool takeSnapshot = false;
-        bool inTarget = false;
-
-        // UI state variables
-        ImFont *fontTitle;
-        int widthParameterWindow = 350;
-        float widthItemSpacing = 180;
-        int frameLastAction = 0;
-        int frameCount = 0;
-        float imageMovement = 0.0f;
-        int snapID = -1;
-        float snapshotDensity = 0.06f;
-        std::string loadingSequence = "/-\\|";
-
-        // Camera specific state variables
-        int camID = 0;
-        int fpsID = 0;
-        int fmtID = 0;
-        std::vector<int> cameraFPS{5, 10, 15, 20, 30, 50, 60, 100, 120};
-        std::vector<std::string> cameraFMTS{"YUVY", "YUY2", "YU12", "YV12", "RGB3", "BGR3", "Y16 ", "MJPG", "MPEG", "X264", "HEVC"};
-        std::vector<std::string> cameras;
+    enum CalibrationSolver {
+        SOLVER_OPENCV = 0,
+        SOLVER_SPARSE = 1
     };
 
     struct CalibrationParameters {
@@ -105,6 +134,8 @@ namespace ccalib {
         cv::Mat D = cv::Mat::zeros(8, 1, CV_64F);
         cv::Mat P = cv::Mat::zeros(3, 4, CV_64F);
         std::vector<cv::Mat> R, T;
+        std::vector<int> viewIds;   // snapshot id of every R, T
+        cv::Size imageSize;
         double reprojErr = DBL_MAX;
         double reprojErrVar = DBL_MAX;
     };
@@ -0,0 +1,105 @@
+#include <opencv2/opencv.hpp>
+#include "texture.h"
+#include "profiler.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Streaming Preview Texture
+ * =====================================================================
+ * The texture and two pixel unpack buffers are allocated once per
+ * resolution. Every frame is written into the mapped buffer that was
+ * not used by the previous upload, so glTexSubImage2D can transfer
+ * asynchronously while the CPU already fills the next frame. Gray
+ * images are expanded to RGB while writing into the buffer.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    PreviewTexture::PreviewTexture() {}
+
+    // GL objects are freed in release(), the context is gone by now
+    PreviewTexture::~PreviewTexture() {}
+
+    void PreviewTexture::allocate(const cv::Size &imgSize) {
+        release();
+        size = imgSize;
+        auto bytes = (GLsizeiptr) size.area() * 3;
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, size.width, size.height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+
+        glGenBuffers(2, buffers);
+        for (auto buffer : buffers) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        current = 0;
+    }
+
+    /**
+     * Streams an 8 bit gray or RGB image into the texture. Storage is only
+     * reallocated if the resolution changes.
+     *
+     * @param image image to display
+     */
+    void PreviewTexture::upload(const cv::Mat &image) {
+        if (image.empty())
+            return;
+        ScopedTimer timer("Upload");
+        CV_Assert(image.depth() == CV_8U && (image.channels() == 1 || image.channels() == 3));
+        if (texture == 0 || image.size() != size)
+            allocate(image.size());
+
+        // Alternate buffers so mapping never waits for the transfer in flight
+        current = 1 - current;
+        auto bytes = (GLsizeiptr) size.area() * 3;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[current]);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped) {
+            cv::Mat pixels(size, CV_8UC3, mapped);
+            if (image.channels() == 1)
+                cv::cvtColor(image, pixels, cv::COLOR_GRAY2RGB);
+            else
+                image.copyTo(pixels);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+            // Rows are tightly packed, source is the bound buffer
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width, size.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void PreviewTexture::release() {
+        if (texture != 0) {
+            glDeleteTextures(1, &texture);
+            glDeleteBuffers(2, buffers);
+        }
+        texture = 0;
+        buffers[0] = buffers[1] = 0;
+        size = cv::Size();
+    }
+
+    GLuint PreviewTexture::id() {
+        return texture;
+    }
+
+    cv::Size PreviewTexture::getSize() {
+        return size;
+    }
+
+} // namespace ccalib
@@ -0,0 +1,35 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <opencv2/core/mat.hpp>
+
+namespace ccalib {
+
+    class PreviewTexture {
+    private:
+        GLuint texture = 0;
+        GLuint buffers[2] = {0, 0};     // pixel unpack buffers, used alternately
+        int current = 0;
+        cv::Size size;
+
+        void allocate(const cv::Size &imgSize);
+
+    public:
+
+        PreviewTexture();
+
+        ~PreviewTexture();
+
+        void upload(const cv::Mat &image);
+
+        void release();
+
+        GLuint id();
+
+        cv::Size getSize();
+    };
+
+} // namespace ccalib
+
+#endif // TEXTURE_H
@@ -0,0 +1,103 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+namespace ccalib {
+
+    /**
+     * =====================================================================
+     * Lock-free Triple Buffer
+     * =====================================================================
+     * Single producer / single consumer latest-value handoff.
+     * The producer fills the back slot and publishes it by swapping it with
+     * the middle slot, the consumer swaps its front slot with the middle
+     * slot whenever new data is available. Neither side ever blocks and
+     * the consumer always sees a completely written slot.
+     * =====================================================================
+     */
+    template<typename T>
+    class TripleBuffer {
+    private:
+        static constexpr uint8_t INDEX_MASK = 0x3;
+        static constexpr uint8_t NEW_DATA = 0x4;
+
+        T slots[3];
+        std::atomic<uint8_t> middle{1};
+        std::atomic<uint64_t> sequence{0};
+        uint8_t back = 0;
+        uint8_t front = 2;
+
+    public:
+
+        /**
+         * Slot owned by the producer, only valid until the next publish().
+         */
+        T &writeBuffer() {
+            return slots[back];
+        }
+
+        /**
+         * Hands the back slot over to the consumer and takes the middle slot
+         * as new back slot. That slot might still contain data which was never
+         * consumed or which the consumer released.
+         *
+         * @return sequence number of the published slot
+         */
+        uint64_t publish() {
+            uint8_t previous = middle.exchange(back | NEW_DATA, std::memory_order_acq_rel);
+            back = previous & INDEX_MASK;
+            return sequence.fetch_add(1, std::memory_order_acq_rel) + 1;
+        }
+
+        /**
+         * Swaps the front slot with the latest published one, if any.
+         *
+         * @return true if the front slot has been updated
+         */
+        bool update() {
+            if (!(middle.load(std::memory_order_acquire) & NEW_DATA))
+                return false;
+            uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+            front = previous & INDEX_MASK;
+            return true;
+        }
+
+        /**
+         * Slot owned by the consumer, only valid until the next update().
+         */
+        T &readBuffer() {
+            return slots[front];
+        }
+
+        /**
+         * @return true if a slot has been published since the last update()
+         */
+        bool hasNewData() const {
+            return (middle.load(std::memory_order_acquire) & NEW_DATA) != 0;
+        }
+
+        /**
+         * Number of slots published so far. Keeps counting across reset(),
+         * so a consumer comparing against an older value never misses data.
+         */
+        uint64_t getSequence() const {
+            return sequence.load(std::memory_order_acquire);
+        }
+
+        /**
+         * Clears all slots. Only safe while neither side is active.
+         */
+        void reset() {
+            for (auto &s : slots)
+                s = T();
+            middle.store(1, std::memory_order_release);
+            back = 0;
+            front = 2;
+        }
+    };
+
+} // namespace ccalib
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,81 @@
+#include "undistorter.h"
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Cached Undistortion
+ * =====================================================================
+ * cv::undistort rebuilds the undistortion map on every call. The maps
+ * are built once per camera matrix, distortion and image size in fixed
+ * point form instead, every frame is then a single remap. Mirroring of
+ * the preview is folded into the same maps, so undistorting and flipping
+ * a frame is one pass over the image.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    Undistorter::Undistorter() {}
+
+    Undistorter::~Undistorter() {}
+
+    /**
+     * Rebuilds the maps if the calibration, image size or mirroring changed.
+     *
+     * @param cameraMatrix camera matrix K
+     * @param distCoeffs distortion coefficients D
+     * @param imgSize size of the images to undistort
+     * @param mirrored flip the undistorted image horizontally
+     * @return true if the maps have been rebuilt
+     */
+    bool Undistorter::update(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Size &imgSize,
+                             const bool &mirrored) {
+        auto same = [](const cv::Mat &a, const cv::Mat &b) {
+            return a.size() == b.size() && a.type() == b.type() && (a.empty() || cv::norm(a, b, cv::NORM_INF) == 0.0);
+        };
+        if (isReady() && imgSize == size && mirrored == mirror && same(cameraMatrix, K) && same(distCoeffs, D))
+            return false;
+
+        K = cameraMatrix.clone();
+        D = distCoeffs.clone();
+        size = imgSize;
+        mirror = mirrored;
+        cv::initUndistortRectifyMap(K, D, cv::noArray(), K, size, CV_16SC2, map1, map2);
+
+        // Output column x takes the source position of column width - 1 - x
+        if (mirror) {
+            cv::flip(map1, map1, 1);
+            cv::flip(map2, map2, 1);
+        }
+        return true;
+    }
+
+    /**
+     * Same as cv::undistort, followed by cv::flip if mirrored, with the
+     * cached maps. The destination must not share its buffer with the source.
+     */
+    void Undistorter::undistort(const cv::Mat &src, cv::Mat &dst) {
+        if (!isReady() || src.size() != size) {
+            src.copyTo(dst);
+            return;
+        }
+        cv::remap(src, dst, map1, map2, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    }
+
+    void Undistorter::reset() {
+        map1.release();
+        map2.release();
+        K.release();
+        D.release();
+        size = cv::Size();
+        mirror = false;
+    }
+
+    bool Undistorter::isReady() {
+        return !map1.empty();
+    }
+
+} // namespace ccalib
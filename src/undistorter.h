@@ -0,0 +1,33 @@
+#ifndef UNDISTORTER_H
+#define UNDISTORTER_H
+
+#include <opencv2/opencv.hpp>
+
+namespace ccalib {
+
+    class Undistorter {
+    private:
+        cv::Mat map1, map2;     // fixed point maps, CV_16SC2 and CV_16UC1
+        cv::Mat K, D;
+        cv::Size size;
+        bool mirror = false;
+
+    public:
+
+        Undistorter();
+
+        ~Undistorter();
+
+        bool update(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs, const cv::Size &imgSize,
+                    const bool &mirrored = false);
+
+        void undistort(const cv::Mat &src, cv::Mat &dst);
+
+        void reset();
+
+        bool isReady();
+    };
+
+} // namespace ccalib
+
+#endif // UNDISTORTER_H
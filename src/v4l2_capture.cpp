@@ -0,0 +1,312 @@
+#include "v4l2_capture.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+using namespace std;
+
+
+/**
+ * =====================================================================
+ * Native V4L2 Capture using memory mapped streaming I/O
+ * =====================================================================
+ * Talks to the device directly with VIDIOC_REQBUFS / QBUF / DQBUF.
+ * Dequeued frames are handed out as cv::Mat headers pointing into the
+ * mmap'd driver buffers, so no copy or decode happens on capture.
+ * A buffer stays owned by the caller until it is enqueued again.
+ * =====================================================================
+ */
+
+namespace ccalib {
+
+    V4L2Capture::V4L2Capture() {}
+
+    V4L2Capture::V4L2Capture(const int &ringSize) : ringSize(ringSize) {}
+
+    V4L2Capture::~V4L2Capture() {
+        close();
+    }
+
+    int V4L2Capture::xioctl(unsigned long request, void *arg) {
+        int r;
+        do {
+            r = ioctl(fd, request, arg);
+        } while (r == -1 && errno == EINTR);
+        return r;
+    }
+
+    bool V4L2Capture::open(const string &device) {
+        close();
+        fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK);
+        if (fd == -1) {
+            printf("V4L2 device %s could not be opened: %s\n", device.c_str(), strerror(errno));
+            return false;
+        }
+
+        // Device needs to support streaming I/O for mmap capture
+        v4l2_capability cap{};
+        if (xioctl(VIDIOC_QUERYCAP, &cap) == -1 || !(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE) ||
+            !(cap.capabilities & V4L2_CAP_STREAMING)) {
+            printf("V4L2 device %s does not support streaming capture!\n", device.c_str());
+            close();
+            return false;
+        }
+
+        // Read out current format
+        v4l2_format fmt{};
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (xioctl(VIDIOC_G_FMT, &fmt) != -1) {
+            pixelFormat = fmt.fmt.pix.pixelformat;
+            width = (int) fmt.fmt.pix.width;
+            height = (int) fmt.fmt.pix.height;
+            bytesPerLine = (int) fmt.fmt.pix.bytesperline;
+        }
+        return true;
+    }
+
+    void V4L2Capture::close() {
+        stopStream();
+        if (fd != -1)
+            ::close(fd);
+        fd = -1;
+    }
+
+    bool V4L2Capture::isOpened() {
+        return fd != -1;
+    }
+
+    bool V4L2Capture::isStreaming() {
+        return streaming;
+    }
+
+    bool V4L2Capture::setFormat(const uint32_t &fourcc, const int &w, const int &h) {
+        if (!isOpened() || streaming)
+            return false;
+
+        v4l2_format fmt{};
+        fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        fmt.fmt.pix.width = (uint32_t) w;
+        fmt.fmt.pix.height = (uint32_t) h;
+        fmt.fmt.pix.pixelformat = fourcc;
+        fmt.fmt.pix.field = V4L2_FIELD_ANY;
+
+        // The driver adjusts the request to the closest supported format
+        bool success = xioctl(VIDIOC_S_FMT, &fmt) != -1;
+        pixelFormat = fmt.fmt.pix.pixelformat;
+        width = (int) fmt.fmt.pix.width;
+        height = (int) fmt.fmt.pix.height;
+        bytesPerLine = (int) fmt.fmt.pix.bytesperline;
+        return success;
+    }
+
+    bool V4L2Capture::setFramerate(const int &rate) {
+        if (!isOpened() || streaming)
+            return false;
+
+        v4l2_streamparm parm{};
+        parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        parm.parm.capture.timeperframe.numerator = 1;
+        parm.parm.capture.timeperframe.denominator = (uint32_t) rate;
+        bool success = xioctl(VIDIOC_S_PARM, &parm) != -1;
+
+        const v4l2_fract &tpf = parm.parm.capture.timeperframe;
+        fps = tpf.numerator ? (int) (tpf.denominator / tpf.numerator) : rate;
+        return success;
+    }
+
+    bool V4L2Capture::setExposure(const bool &autoExposure, const float &value) {
+        if (!isOpened())
+            return false;
+
+        v4l2_control ctrl{};
+        ctrl.id = V4L2_CID_EXPOSURE_AUTO;
+        ctrl.value = autoExposure ? V4L2_EXPOSURE_APERTURE_PRIORITY : V4L2_EXPOSURE_MANUAL;
+        xioctl(VIDIOC_S_CTRL, &ctrl);
+
+        // Exposure is normalized to [0, 1] like the OpenCV backend does
+        v4l2_queryctrl query{};
+        query.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+        if (xioctl(VIDIOC_QUERYCTRL, &query) == -1 || query.flags & V4L2_CTRL_FLAG_DISABLED)
+            return false;
+
+        ctrl.id = V4L2_CID_EXPOSURE_ABSOLUTE;
+        ctrl.value = query.minimum + (int) (value * (query.maximum - query.minimum));
+        if (xioctl(VIDIOC_S_CTRL, &ctrl) == -1)
+            return false;
+
+        exposure = (float) (ctrl.value - query.minimum) / max(1, query.maximum - query.minimum);
+        return true;
+    }
+
+    void V4L2Capture::setRingSize(const int &size) {
+        if (!streaming)
+            ringSize = max(2, size);
+    }
+
+    bool V4L2Capture::allocateBuffers() {
+        v4l2_requestbuffers req{};
+        req.count = (uint32_t) ringSize;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(VIDIOC_REQBUFS, &req) == -1 || req.count < 2) {
+            printf("V4L2 buffer request failed: %s\n", strerror(errno));
+            return false;
+        }
+
+        // Map every driver buffer into our address space
+        buffers.resize(req.count);
+        for (uint32_t i = 0; i < req.count; i++) {
+            v4l2_buffer buf{};
+            buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            buf.memory = V4L2_MEMORY_MMAP;
+            buf.index = i;
+            if (xioctl(VIDIOC_QUERYBUF, &buf) == -1)
+                return false;
+
+            buffers[i].length = buf.length;
+            buffers[i].start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, buf.m.offset);
+            if (buffers[i].start == MAP_FAILED) {
+                buffers[i].start = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void V4L2Capture::releaseBuffers() {
+        for (auto &b : buffers)
+            if (b.start)
+                munmap(b.start, b.length);
+        buffers.clear();
+
+        // Free driver side buffers
+        v4l2_requestbuffers req{};
+        req.count = 0;
+        req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        req.memory = V4L2_MEMORY_MMAP;
+        xioctl(VIDIOC_REQBUFS, &req);
+    }
+
+    bool V4L2Capture::startStream() {
+        if (!isOpened() || streaming)
+            return streaming;
+
+        if (!allocateBuffers()) {
+            releaseBuffers();
+            return false;
+        }
+
+        // Hand all buffers to the driver
+        for (int i = 0; i < (int) buffers.size(); i++)
+            enqueue(i);
+
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        if (xioctl(VIDIOC_STREAMON, &type) == -1) {
+            releaseBuffers();
+            return false;
+        }
+        streaming = true;
+        return true;
+    }
+
+    void V4L2Capture::stopStream() {
+        if (!streaming)
+            return;
+
+        // STREAMOFF implicitly dequeues all buffers
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(VIDIOC_STREAMOFF, &type);
+        releaseBuffers();
+        streaming = false;
+    }
+
+    /**
+     * Waits for the next filled buffer and wraps it into a cv::Mat header
+     * without copying. The buffer remains owned by the caller and must be
+     * returned with enqueue() before the driver can fill it again.
+     * Raw formats are exposed with their native layout, compressed formats
+     * as a single row of bytes.
+     *
+     * @param frame cv::Mat header pointing to the mapped buffer
+     * @param timeoutMs time to wait for a frame
+     * @return buffer index or -1 if no frame is available
+     */
+    int V4L2Capture::dequeue(cv::Mat &frame, const int &timeoutMs) {
+        if (!streaming)
+            return -1;
+
+        pollfd pfd{fd, POLLIN, 0};
+        if (poll(&pfd, 1, timeoutMs) <= 0)
+            return -1;
+
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        if (xioctl(VIDIOC_DQBUF, &buf) == -1)
+            return -1;
+
+        auto *data = static_cast<uchar *>(buffers[buf.index].start);
+        auto step = bytesPerLine > 0 ? (size_t) bytesPerLine : cv::Mat::AUTO_STEP;
+        switch (pixelFormat) {
+            case V4L2_PIX_FMT_YUYV:
+                frame = cv::Mat(height, width, CV_8UC2, data, step);
+                break;
+            case V4L2_PIX_FMT_GREY:
+                frame = cv::Mat(height, width, CV_8UC1, data, step);
+                break;
+            case V4L2_PIX_FMT_Y16:
+                frame = cv::Mat(height, width, CV_16UC1, data, step);
+                break;
+            case V4L2_PIX_FMT_RGB24:
+            case V4L2_PIX_FMT_BGR24:
+                frame = cv::Mat(height, width, CV_8UC3, data, step);
+                break;
+            default:
+                frame = cv::Mat(1, (int) buf.bytesused, CV_8UC1, data);
+        }
+        return (int) buf.index;
+    }
+
+    bool V4L2Capture::enqueue(const int &index) {
+        if (index < 0 || index >= (int) buffers.size())
+            return false;
+
+        v4l2_buffer buf{};
+        buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index = (uint32_t) index;
+        return xioctl(VIDIOC_QBUF, &buf) != -1;
+    }
+
+    uint32_t V4L2Capture::getFormat() {
+        return pixelFormat;
+    }
+
+    int V4L2Capture::getWidth() {
+        return width;
+    }
+
+    int V4L2Capture::getHeight() {
+        return height;
+    }
+
+    int V4L2Capture::getFramerate() {
+        return fps;
+    }
+
+    float V4L2Capture::getExposure() {
+        return exposure;
+    }
+
+    int V4L2Capture::getRingSize() {
+        return ringSize;
+    }
+
+} // namespace ccalib
@@ -0,0 +1,84 @@
+#ifndef V4L2_CAPTURE_H
+#define V4L2_CAPTURE_H
+
+#include <string>
+#include <vector>
+#include <linux/videodev2.h>
+#include <opencv2/core/mat.hpp>
+
+namespace ccalib {
+
+    struct V4L2Buffer {
+        void *start = nullptr;
+        size_t length = 0;
+    };
+
+    class V4L2Capture {
+    private:
+        int fd = -1;
+        int ringSize = 4;
+        bool streaming = false;
+
+        uint32_t pixelFormat = 0;
+        int width = 0;
+        int height = 0;
+        int bytesPerLine = 0;
+        int fps = 0;
+        float exposure = 0.0f;
+
+        std::vector<V4L2Buffer> buffers;
+
+        int xioctl(unsigned long request, void *arg);
+
+        bool allocateBuffers();
+
+        void releaseBuffers();
+
+    public:
+
+        V4L2Capture();
+
+        explicit V4L2Capture(const int &ringSize);
+
+        ~V4L2Capture();
+
+        bool open(const std::string &device);
+
+        void close();
+
+        bool isOpened();
+
+        bool isStreaming();
+
+        bool setFormat(const uint32_t &fourcc, const int &width, const int &height);
+
+        bool setFramerate(const int &fps);
+
+        bool setExposure(const bool &autoExposure, const float &exposure);
+
+        void setRingSize(const int &size);
+
+        bool startStream();
+
+        void stopStream();
+
+        int dequeue(cv::Mat &frame, const int &timeoutMs = 1000);
+
+        bool enqueue(const int &index);
+
+        uint32_t getFormat();
+
+        int getWidth();
+
+        int getHeight();
+
+        int getFramerate();
+
+        float getExposure();
+
+        int getRingSize();
+    };
+
+} // namespace ccalib
+
+#endif // V4L2_CAPTURE_H